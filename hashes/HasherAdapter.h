@@ -2,6 +2,7 @@
 #define HASHER_ADAPTER_H_
 
 #include <cstdint>
+#include <string>
 #include <string_view>
 
 namespace {
@@ -10,6 +11,9 @@ template<typename THasher>
 class CHasherAdapter
 {
 public:
+    // Strings and string views of the same characters hash the same
+    using is_transparent = void;
+
     CHasherAdapter() = default;
 
     explicit CHasherAdapter(const THasher& hasher):
@@ -34,6 +38,19 @@ public:
                        key.size());
     }
 
+    // Otherwise the generic overload would hash the string object itself
+    [[nodiscard]]
+    size_t operator()(const std::string& key) const
+    {
+        return (*this)(std::string_view(key));
+    }
+
+    [[nodiscard]]
+    size_t operator()(const char* key) const
+    {
+        return (*this)(std::string_view(key));
+    }
+
     template<typename TKey>
     [[nodiscard]]
     size_t operator()(const TKey& key) const
@@ -20,17 +20,16 @@ public:
     virtual size_t operator()
         (const uint8_t* data, size_t size) const final override
     {
-        MD5(data, size, hash_);
+        // Digest lives on the stack, so the hasher may be shared by
+        // threads
+        unsigned char hash[MD5_DIGEST_LENGTH] = {};
+        MD5(data, size, hash);
 
         size_t result = 0u;
-        std::memcpy(&result, hash_, sizeof(result));
+        std::memcpy(&result, hash, sizeof(result));
 
         return result;
     }
-
-private:
-    alignas(sizeof(size_t)) mutable
-    unsigned char hash_[MD5_DIGEST_LENGTH] = {};
 };
 
 } // namespace
@@ -64,7 +64,7 @@ public:
         (const uint8_t* data, size_t size) const final override
     {
         unsigned int hash_len = 0u;
-        std::fill(std::begin(hash_), std::end(hash_), 0x00);
+        unsigned char hash[EVP_MAX_MD_SIZE] = {};
 
         if (EVP_DigestInit_ex(context_, type_, NULL) != 1)
             throw std::runtime_error("error: EVP_DigestInit_ex()");
@@ -72,12 +72,12 @@ public:
         if (EVP_DigestUpdate(context_, data, size) != 1)
             throw std::runtime_error("error: EVP_DigestUpdate()");
 
-        if (EVP_DigestFinal_ex(context_, hash_, &hash_len) != 1)
+        if (EVP_DigestFinal_ex(context_, hash, &hash_len) != 1)
             throw std::runtime_error("error: EVP_DigestFinal_ex()");
 
         size_t result = 0u;
         for (unsigned int idx = 0u; idx < hash_len; ++idx)
-            result ^= (static_cast<size_t>(hash_[idx]) + 0x9e3779b9 + 
+            result ^= (static_cast<size_t>(hash[idx]) + 0x9e3779b9 + 
                        (result << 6) + (result >> 2));
 
         return result;
@@ -85,9 +85,9 @@ public:
 
 private:
     const EVP_MD* type_ = NULL;
+    // Reused by every call, so one hasher must not be used by several
+    // threads at once
     EVP_MD_CTX* context_ = NULL;
-
-    mutable unsigned char hash_[EVP_MAX_MD_SIZE] = {};
 };
 
 } // namespace
@@ -5,6 +5,11 @@
 #include "OpenDoubleAddrHashTable.h"
 #include "ChainHashTable.h"
 #include "CuckooHashTable.h"
+#include "SwissHashTable.h"
+#include "RobinHoodHashTable.h"
+#include "BucketCuckooHashTable.h"
+#include "DaryCuckooHashTable.h"
+#include "HopscotchHashTable.h"
 
 #include "IHasher.h"
 #include "HasherAdapter.h"
@@ -59,6 +64,34 @@ template<typename THash> // "cuckoo"
 using TCuckooHT = CCuckooHashTable<TBenchKey, TBenchValue, THash, 
                                    std::hash<TBenchKey>>;
 
+template<typename THash> // "swiss"
+using TSwissHT = CSwissHashTable<TBenchKey, TBenchValue, THash>;
+
+template<typename THash> // "robin75"
+using TRobin75HT = CRobinHoodHashTable<TBenchKey, TBenchValue, THash, 4u>;
+
+template<typename THash> // "robin95"
+using TRobin95HT = CRobinHoodHashTable<TBenchKey, TBenchValue, THash, 20u>;
+
+template<typename THash> // "bucket"
+using TBucketHT = CBucketCuckooHashTable<TBenchKey, TBenchValue, THash>;
+
+template<typename THash> // "cuckoo3"
+using TCuckoo3HT = CDaryCuckooHashTable<TBenchKey, TBenchValue, 
+                                        THash, THash, THash>;
+
+template<typename THash> // "cuckoo4"
+using TCuckoo4HT = CDaryCuckooHashTable<TBenchKey, TBenchValue, 
+                                        THash, THash, THash, THash>;
+
+template<typename THash> // "hop32"
+using THop32HT = CHopscotchHashTable<TBenchKey, TBenchValue, THash, 10u, 
+                                     CPow2Capacity, 32u>;
+
+template<typename THash> // "hop64"
+using THop64HT = CHopscotchHashTable<TBenchKey, TBenchValue, THash, 10u, 
+                                     CPow2Capacity, 64u>;
+
 // "std"
 using TStdHF = std::hash<TBenchKey>;
 // "murmur3"
@@ -114,7 +147,9 @@ int main(int argc, char* argv[])
             " TABLE_TYPE HASHER_TYPE OUTFILE\n";
         std::cerr << 
             "TABLE TYPES:\n" 
-            "linear quadro double chain75 chain95 cuckoo\n";
+            "linear quadro double chain75 chain95 cuckoo\n"
+            "swiss robin75 robin95 bucket cuckoo3 cuckoo4\n"
+            "hop32 hop64\n";
         std::cerr << 
             "HASHER TYPES:\n" 
             "std murmur3 sha256 md5 polynomial tabulation rabinkarp addition\n";
@@ -148,7 +183,9 @@ int main(int argc, char* argv[])
         std::cerr << exc.what() << '\n';
         std::cerr << 
             "TABLE TYPES:\n" 
-            "linear quadro double chain75 chain95 cuckoo\n";
+            "linear quadro double chain75 chain95 cuckoo\n"
+            "swiss robin75 robin95 bucket cuckoo3 cuckoo4\n"
+            "hop32 hop64\n";
         std::cerr << 
             "HASHER TYPES:\n" 
             "std murmur3 sha256 md5 polynomial tabulation rabinkarp addition\n";
@@ -278,6 +315,22 @@ launch_table(std::string_view table_name,
         return launch_hash<TChain95HT>(hash_name);
     if (table_name == "cuckoo")
         return launch_hash<TCuckooHT>(hash_name);
+    if (table_name == "swiss")
+        return launch_hash<TSwissHT>(hash_name);
+    if (table_name == "robin75")
+        return launch_hash<TRobin75HT>(hash_name);
+    if (table_name == "robin95")
+        return launch_hash<TRobin95HT>(hash_name);
+    if (table_name == "bucket")
+        return launch_hash<TBucketHT>(hash_name);
+    if (table_name == "cuckoo3")
+        return launch_hash<TCuckoo3HT>(hash_name);
+    if (table_name == "cuckoo4")
+        return launch_hash<TCuckoo4HT>(hash_name);
+    if (table_name == "hop32")
+        return launch_hash<THop32HT>(hash_name);
+    if (table_name == "hop64")
+        return launch_hash<THop64HT>(hash_name);
 
     throw std::invalid_argument("error: no such table type");
 }
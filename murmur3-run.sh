@@ -29,3 +29,35 @@ echo 'GENERATED bench/chain95-murmur3.txt'
 echo 'LAUNCH cuckoo murmur3...'
 ./bin/main cuckoo murmur3 bench/cuckoo-murmur3.txt $1
 echo 'GENERATED bench/cuckoo-murmur3.txt'
+
+echo 'LAUNCH swiss murmur3...'
+./bin/main swiss murmur3 bench/swiss-murmur3.txt $1
+echo 'GENERATED bench/swiss-murmur3.txt'
+
+echo 'LAUNCH robin75 murmur3...'
+./bin/main robin75 murmur3 bench/robin75-murmur3.txt $1
+echo 'GENERATED bench/robin75-murmur3.txt'
+
+echo 'LAUNCH robin95 murmur3...'
+./bin/main robin95 murmur3 bench/robin95-murmur3.txt $1
+echo 'GENERATED bench/robin95-murmur3.txt'
+
+echo 'LAUNCH bucket murmur3...'
+./bin/main bucket murmur3 bench/bucket-murmur3.txt $1
+echo 'GENERATED bench/bucket-murmur3.txt'
+
+echo 'LAUNCH cuckoo3 murmur3...'
+./bin/main cuckoo3 murmur3 bench/cuckoo3-murmur3.txt $1
+echo 'GENERATED bench/cuckoo3-murmur3.txt'
+
+echo 'LAUNCH cuckoo4 murmur3...'
+./bin/main cuckoo4 murmur3 bench/cuckoo4-murmur3.txt $1
+echo 'GENERATED bench/cuckoo4-murmur3.txt'
+
+echo 'LAUNCH hop32 murmur3...'
+./bin/main hop32 murmur3 bench/hop32-murmur3.txt $1
+echo 'GENERATED bench/hop32-murmur3.txt'
+
+echo 'LAUNCH hop64 murmur3...'
+./bin/main hop64 murmur3 bench/hop64-murmur3.txt $1
+echo 'GENERATED bench/hop64-murmur3.txt'
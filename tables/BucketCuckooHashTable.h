@@ -0,0 +1,638 @@
+#ifndef BUCKET_CUCKOO_HASHTABLE_H_
+#define BUCKET_CUCKOO_HASHTABLE_H_
+
+#include "IHashTable.h"
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+namespace {
+
+// Tags of one bucket matched at once, zero tag marks an empty slot
+class CTagBucket
+{
+public:
+    static constexpr size_t NWidth = 8u;
+
+    static constexpr uint8_t NTagEmpty = 0u;
+
+    explicit CTagBucket(const uint8_t* tags) noexcept
+#ifdef __SSE2__
+        : tags_(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(tags)))
+    {}
+#else
+    {
+        std::memcpy(&tags_, tags, NWidth);
+    }
+#endif // __SSE2__
+
+    // Non-zero mask if some slot holds `tag`, see lowest() for its layout
+    [[nodiscard]]
+    inline uint64_t match(uint8_t tag) const noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_set1_epi8(static_cast<char>(tag)), tags_))) & 0xFFu;
+#else
+        // High bit of every byte that is zero after xor, with no carries
+        // between bytes, so there are no false positives
+        constexpr uint64_t NLow = 0x7F7F7F7F7F7F7F7Fu;
+        uint64_t diff = tags_ ^ (0x0101010101010101u * tag);
+
+        return ~(((diff & NLow) + NLow) | diff | NLow);
+#endif // __SSE2__
+    }
+
+    [[nodiscard]]
+    inline uint64_t match_empty() const noexcept
+    {
+        return match(NTagEmpty);
+    }
+
+    // SSE2 gives a bit per slot, the scalar version a high bit per byte
+    [[nodiscard]]
+    static inline size_t lowest(uint64_t mask) noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<size_t>(__builtin_ctzll(mask));
+#else
+        return static_cast<size_t>(__builtin_ctzll(mask)) / 8u;
+#endif // __SSE2__
+    }
+
+private:
+#ifdef __SSE2__
+    __m128i tags_;
+#else
+    uint64_t tags_;
+#endif // __SSE2__
+};
+
+// Cuckoo hashing over buckets of NBucketWidth slots: every key may live in
+// either of two buckets, so a lookup reads at most two tag words. The second
+// bucket is derived from the first one and the tag (partial-key cuckoo),
+// which lets eviction move a key without hashing it again.
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 16u>
+class CBucketCuckooHashTable final : public IHashTable<TK, TV>
+{
+public:
+    using typename IHashTable<TK, TV>::TKey;
+    using typename IHashTable<TK, TV>::TValue;
+    using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
+    using THasher = TH;
+
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    static constexpr size_t NBucketWidth = CTagBucket::NWidth;
+    static constexpr size_t NStartCapacity = NBucketWidth;
+    static constexpr size_t NLoadRatio = NLR;
+    static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+
+    // Eviction walk length after which the table grows
+    static constexpr size_t NMaxKicks = 256u;
+
+    // A failed walk grows the table only while it is at least
+    // 1/NSpillRatio full, see settle()
+    static constexpr size_t NSpillRatio = 4u;
+
+    CBucketCuckooHashTable() = default;
+
+    template<typename TIter>
+    CBucketCuckooHashTable(TIter begin_it, TIter end_it):
+        CBucketCuckooHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CBucketCuckooHashTable(const CBucketCuckooHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        victim_seed_(other.victim_seed_),
+        hasher_(other.hasher_),
+        tag_vec_(other.tag_vec_),
+        data_vec_(other.data_vec_.size()),
+        overflow_list_(other.overflow_list_)
+    {
+        for (size_t index = 0u; index < tag_vec_.size(); ++index)
+        {
+            if (tag_vec_[index] != CTagBucket::NTagEmpty)
+                construct_at(index, other.get_data_at(index));
+        }
+    }
+
+    CBucketCuckooHashTable& operator = (const CBucketCuckooHashTable& other)
+    {
+        if (this != &other)
+        {
+            CBucketCuckooHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CBucketCuckooHashTable(CBucketCuckooHashTable&& other) noexcept:
+        CBucketCuckooHashTable()
+    {
+        swap(other);
+    }
+
+    CBucketCuckooHashTable& operator = (
+            CBucketCuckooHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CBucketCuckooHashTable() final
+    {
+        for (size_t index = 0u; index < tag_vec_.size(); ++index)
+        {
+            if (tag_vec_[index] != CTagBucket::NTagEmpty)
+                destruct_at(index);
+        }
+    }
+
+    void swap(CBucketCuckooHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(victim_seed_, other.victim_seed_);
+        std::swap(hasher_, other.hasher_);
+        std::swap(tag_vec_, other.tag_vec_);
+        std::swap(data_vec_, other.data_vec_);
+        std::swap(overflow_list_, other.overflow_list_);
+    }
+
+    [[nodiscard]]
+    virtual size_t size() const noexcept override final
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    virtual size_t capacity() const noexcept override final
+    {
+        return tag_vec_.size();
+    }
+
+    [[nodiscard]]
+    virtual bool empty() const noexcept override final
+    {
+        return size_ == 0u;
+    }
+
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = CPow2Capacity::round(
+                std::max(capacity_for(count, NLoadRatio), NBucketWidth));
+        if (new_capacity > capacity())
+            rehash(new_capacity);
+    }
+
+    virtual bool insert(const TKey& desired,
+                        const TValue& desired_value) override final
+    {
+        return emplace_core<true>(desired, desired_value);
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>>
+        find(const TKey& desired) override final
+    {
+        auto result =
+            const_cast<const CBucketCuckooHashTable&>(*this).find(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const override final
+    {
+        return find_core(desired);
+    }
+
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    using IHashTable<TK, TV>::capacity_for;
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        size_t hash = hasher_(desired);
+        if (size_t found = search(desired, hash); found != capacity())
+        {
+            if constexpr (NAssign)
+                get_data_at(found).second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+        {
+            if constexpr (NAssign)
+                found->second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (capacity() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
+            rehash(capacity() * NRehashFactor);
+
+        TStorage buffer;
+        new (&buffer) TData{ std::piecewise_construct,
+            std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+            std::forward_as_tuple(std::forward<Types>(args)...) };
+        settle(buffer);
+
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        size_t found = search(desired, hasher_(desired));
+        if (found == capacity())
+        {
+            auto overflow = search_overflow(desired);
+            if (overflow == overflow_list_.end())
+                return false;
+
+            overflow_list_.erase(overflow);
+            --size_;
+
+            return true;
+        }
+
+        destruct_at(found);
+        tag_vec_[found] = CTagBucket::NTagEmpty;
+        --size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (size_t found = search(desired, hasher_(desired));
+            found != capacity())
+        {
+            auto& [key, value] = get_data_at(found);
+            return std::make_optional(std::cref(value));
+        }
+
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+            return std::make_optional(std::cref(found->second));
+
+        return std::nullopt;
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(size_t idx, Types&&... args)
+    {
+        return new (&data_vec_[idx]) TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(size_t idx)
+    {
+        std::launder(reinterpret_cast<TData*>(&data_vec_[idx]))->~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(size_t idx) const noexcept
+    {
+        return const_cast<CBucketCuckooHashTable*>(this)->get_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&data_vec_[idx]));
+    }
+
+    [[nodiscard]]
+    static inline TData& get_buffer_data(TStorage& buffer) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&buffer));
+    }
+
+    [[nodiscard]]
+    inline size_t bucket_count() const noexcept
+    {
+        return capacity() / NBucketWidth;
+    }
+
+    // Tag is taken from the mixed hash, so weak hashers still spread it
+    [[nodiscard]]
+    static inline uint8_t tag_of(size_t hash) noexcept
+    {
+        auto tag = static_cast<uint8_t>(
+                (static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15u) >> 56u);
+
+        return (tag == CTagBucket::NTagEmpty ? 1u : tag);
+    }
+
+    [[nodiscard]]
+    inline size_t bucket_of(size_t hash) const noexcept
+    {
+        return hash & (bucket_count() - 1u);
+    }
+
+    // Involution as bucket count is a power of 2: the alternative bucket
+    // of the alternative bucket is the original one
+    [[nodiscard]]
+    inline size_t alt_of(size_t bucket, uint8_t tag) const noexcept
+    {
+        return (bucket ^ (tag * 0xC6A4A7935BD1E995u)) & (bucket_count() - 1u);
+    }
+
+    [[nodiscard]]
+    inline size_t next_victim() noexcept
+    {
+        victim_seed_ = victim_seed_ * 6364136223846793005u +
+                       1442695040888963407u;
+
+        return static_cast<size_t>(victim_seed_ >> 61u) % NBucketWidth;
+    }
+
+    // Returns index of the slot holding `desired` or capacity() if none
+    template<typename TKeyLike>
+    [[nodiscard]]
+    size_t search(const TKeyLike& desired, size_t hash) const noexcept
+    {
+        uint8_t tag = tag_of(hash);
+        size_t bucket = bucket_of(hash);
+        for (size_t base : { bucket * NBucketWidth,
+                             alt_of(bucket, tag) * NBucketWidth })
+        {
+            for (uint64_t mask = CTagBucket(&tag_vec_[base]).match(tag);
+                 mask != 0u; mask &= mask - 1u)
+            {
+                size_t index = base + CTagBucket::lowest(mask);
+                if (auto& [key, value] = get_data_at(index); key == desired)
+                    return index;
+            }
+        }
+
+        return capacity();
+    }
+
+    // Holds only keys that did not fit both of their buckets, so it is
+    // empty unless the hasher maps many keys to the same buckets
+    template<typename TKeyLike>
+    [[nodiscard]]
+    typename std::list<TData>::iterator
+        search_overflow(const TKeyLike& desired)
+    {
+        return std::find_if(overflow_list_.begin(), overflow_list_.end(),
+                            [&desired](const TData& data)
+                            { return data.first == desired; });
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    typename std::list<TData>::const_iterator
+        search_overflow(const TKeyLike& desired) const
+    {
+        return const_cast<CBucketCuckooHashTable*>(this)->
+            search_overflow(desired);
+    }
+
+    // Moves the element out of `buffer` into a free slot of `bucket`
+    bool put(size_t bucket, uint8_t tag, TStorage& buffer)
+    {
+        size_t base = bucket * NBucketWidth;
+        uint64_t mask = CTagBucket(&tag_vec_[base]).match_empty();
+        if (mask == 0u)
+            return false;
+
+        size_t index = base + CTagBucket::lowest(mask);
+        construct_at(index, std::move(get_buffer_data(buffer)));
+        tag_vec_[index] = tag;
+        get_buffer_data(buffer).~TData();
+
+        return true;
+    }
+
+    // Places the element held in `buffer`, evicting keys to their other
+    // buckets along a random walk. If the walk is too long the last evicted
+    // element is left in `buffer` and has to be hashed again after growth.
+    bool place(TStorage& buffer, size_t hash)
+    {
+        uint8_t tag = tag_of(hash);
+        size_t bucket = bucket_of(hash);
+        if (put(bucket, tag, buffer))
+            return true;
+
+        bucket = alt_of(bucket, tag);
+        if (put(bucket, tag, buffer))
+            return true;
+
+        TStorage tmp_buffer;
+        for (size_t kick = 0u; kick < NMaxKicks; ++kick)
+        {
+            size_t victim = bucket * NBucketWidth + next_victim();
+
+            new (&tmp_buffer) TData{ std::move(get_data_at(victim)) };
+            destruct_at(victim);
+            construct_at(victim, std::move(get_buffer_data(buffer)));
+            get_buffer_data(buffer).~TData();
+
+            new (&buffer) TData{ std::move(get_buffer_data(tmp_buffer)) };
+            get_buffer_data(tmp_buffer).~TData();
+
+            std::swap(tag, tag_vec_[victim]);
+            bucket = alt_of(bucket, tag);
+            if (put(bucket, tag, buffer))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Places the element held in `buffer`, growing the table while it is
+    // dense enough for growth to help. Keys that do not fit a sparser table
+    // share their buckets, so the element goes to the overflow list instead
+    // of growing the table without bound.
+    void settle(TStorage& buffer)
+    {
+        size_t hash = hasher_(get_buffer_data(buffer).first);
+        while (!place(buffer, hash))
+        {
+            if (capacity() > size_ * NSpillRatio)
+            {
+                overflow_list_.push_back(
+                        std::move(get_buffer_data(buffer)));
+                get_buffer_data(buffer).~TData();
+
+                return;
+            }
+
+            rehash(capacity() * NRehashFactor);
+            hash = hasher_(get_buffer_data(buffer).first);
+        }
+    }
+
+    void rehash(size_t new_capacity)
+    {
+        if (new_capacity % NBucketWidth != 0u ||
+            (new_capacity & (new_capacity - 1u)) != 0u ||
+            new_capacity < size_)
+            throw std::invalid_argument(
+                    "CBucketCuckooHashTable::rehash(): "
+                    "invalid new_capacity"
+                    );
+
+        auto old_tag_vec =
+            std::vector<uint8_t>(new_capacity, CTagBucket::NTagEmpty);
+        auto old_data_vec = std::vector<TStorage>(new_capacity);
+
+        std::list<TData> old_overflow_list;
+
+        std::swap(tag_vec_, old_tag_vec);
+        std::swap(data_vec_, old_data_vec);
+        std::swap(overflow_list_, old_overflow_list);
+
+        // Elements left in the old arrays are not in the new ones, so
+        // growing again in the middle is safe
+        TStorage buffer;
+        for (size_t index = 0u; index < old_tag_vec.size(); ++index)
+        {
+            if (old_tag_vec[index] != CTagBucket::NTagEmpty)
+            {
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                new (&buffer) TData{ std::move(*ptr) };
+                ptr->~TData();
+                settle(buffer);
+            }
+        }
+
+        for (; !old_overflow_list.empty(); old_overflow_list.pop_front())
+        {
+            new (&buffer) TData{ std::move(old_overflow_list.front()) };
+            settle(buffer);
+        }
+    }
+
+private:
+    size_t size_{};
+    uint64_t victim_seed_{};
+    THasher hasher_{};
+
+    std::vector<uint8_t> tag_vec_ =
+        std::vector<uint8_t>(NStartCapacity, CTagBucket::NTagEmpty);
+    std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+
+    std::list<TData> overflow_list_;
+};
+
+} // namespace
+
+#endif // BUCKET_CUCKOO_HASHTABLE_H_
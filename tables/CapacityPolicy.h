@@ -0,0 +1,55 @@
+#ifndef CAPACITY_POLICY_H_
+#define CAPACITY_POLICY_H_
+
+#include <cstddef>
+
+namespace {
+
+// Capacity policies map a hash value onto [0, capacity) and define which
+// capacities a table may have.
+
+// Any capacity, reduction is done with integer division
+class CModCapacity
+{
+public:
+    static constexpr bool NIsPowerOfTwo = false;
+
+    [[nodiscard]]
+    static constexpr size_t round(size_t capacity) noexcept
+    {
+        return (capacity == 0u ? 1u : capacity);
+    }
+
+    [[nodiscard]]
+    static constexpr size_t index(size_t hash, size_t capacity) noexcept
+    {
+        return hash % capacity;
+    }
+};
+
+// Power of 2 capacities only, reduction is a single mask
+class CPow2Capacity
+{
+public:
+    static constexpr bool NIsPowerOfTwo = true;
+
+    [[nodiscard]]
+    static constexpr size_t round(size_t capacity) noexcept
+    {
+        size_t result = 1u;
+        while (result < capacity)
+            result *= 2u;
+
+        return result;
+    }
+
+    [[nodiscard]]
+    static constexpr size_t index(size_t hash, size_t capacity) noexcept
+    {
+        return hash & (capacity - 1u);
+    }
+};
+
+} // namespace
+
+#endif // CAPACITY_POLICY_H_
@@ -2,34 +2,68 @@
 #define CHAIN_HASHTABLE_H_
 
 #include "IHashTable.h"
+#include "CapacityPolicy.h"
+#include "RehashPolicy.h"
+#include "ShrinkPolicy.h"
 
+#include <new>
+#include <algorithm>
+#include <vector>
 #include <utility>
 #include <optional>
 #include <functional>
 #include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <limits>
+#include <cstdint>
 
 namespace {
 
-template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 4>
+// Separate chaining over a node pool: chains are linked with 32-bit node
+// indices, and erased nodes go to a free list, so neither insert nor erase
+// allocates and rehash only relinks the nodes
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 4,
+         class TC = CPow2Capacity, class TR = CFullRehash,
+         class TS = CNoShrink>
 class CChainHashTable final : public IHashTable<TK, TV>
 {
 public:
     static constexpr size_t NLoadRatio = NLR;
+    static constexpr bool NIsTransparent = SIsTransparent<TH>::value;
 
     using typename IHashTable<TK, TV>::TKey;
     using typename IHashTable<TK, TV>::TValue;
     using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
     using THasher = TH;
+    using TCapacity = TC;
+    using TRehash = TR;
+    using TShrink = TS;
 
-    static constexpr size_t NStartCapacity = NLoadRatio;
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    // Index of a node in the pool
+    using TIndex = uint32_t;
+
+    static constexpr size_t NStartCapacity = TCapacity::round(NLoadRatio);
     static constexpr double NRehashFactor = 2.0;
 
+    // End of chain
+    static constexpr TIndex NNil = std::numeric_limits<TIndex>::max();
+
+    // Lookups kept in flight by find_batch()
+    static constexpr size_t NInflight = 16u;
+
     CChainHashTable() = default;
 
     template<typename TIter>
     CChainHashTable(TIter begin_it, TIter end_it):
         CChainHashTable()
     {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
         for (TIter iter = begin_it; iter != end_it; ++iter)
         {
             const auto& [key, value] = *iter;
@@ -37,6 +71,66 @@ public:
         }
     }
 
+    // Links are copied as they are, so nodes keep their indices
+    CChainHashTable(const CChainHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        hasher_(other.hasher_),
+        head_vec_(other.head_vec_),
+        free_head_(other.free_head_),
+        node_count_(other.node_count_),
+        node_vec_(other.node_vec_.size()),
+        migrate_pos_(other.migrate_pos_),
+        old_head_vec_(other.old_head_vec_)
+    {
+        for (TIndex node = 0u; node < node_count_; ++node)
+            node_vec_[node].next = other.node_vec_[node].next;
+
+        for_each_node([this, &other](TIndex node) {
+                construct_at(node, other.get_data_at(node));
+            });
+    }
+
+    CChainHashTable& operator = (const CChainHashTable& other)
+    {
+        if (this != &other)
+        {
+            CChainHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CChainHashTable(CChainHashTable&& other) noexcept:
+        CChainHashTable()
+    {
+        swap(other);
+    }
+
+    CChainHashTable& operator = (CChainHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CChainHashTable() final
+    {
+        for_each_node([this](TIndex node) { destruct_at(node); });
+    }
+
+    void swap(CChainHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(hasher_, other.hasher_);
+        std::swap(head_vec_, other.head_vec_);
+        std::swap(free_head_, other.free_head_);
+        std::swap(node_count_, other.node_count_);
+        std::swap(node_vec_, other.node_vec_);
+        std::swap(migrate_pos_, other.migrate_pos_);
+        std::swap(old_head_vec_, other.old_head_vec_);
+    }
+
     [[nodiscard]]
     virtual size_t size() const noexcept override final
     {
@@ -46,7 +140,7 @@ public:
     [[nodiscard]]
     virtual size_t capacity() const noexcept override final
     {
-        return chain_vec_.size();
+        return head_vec_.size();
     }
 
     [[nodiscard]]
@@ -55,47 +149,76 @@ public:
         return size_ == 0u;
     }
 
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, NLoadRatio));
+        if (new_capacity > capacity())
+        {
+            rehash(new_capacity);
+            complete_rehash();
+        }
+
+        if (count > node_vec_.size())
+            grow_pool(count);
+    }
+
+    // Node pool is compacted too, so erased nodes are given back
+    virtual void shrink_to_fit() override final
+    {
+        if (shrink_to(size_))
+            complete_rehash();
+    }
+
     virtual bool insert(const TKey& desired, 
                         const TValue& desired_value) override final
     {
-        if (chain_vec_.size() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
-            rehash(chain_vec_.size() * NRehashFactor);
+        return emplace_hashed<true>(hasher_(desired), desired, desired_value);
+    }
 
-        size_t index = hasher_(desired) % chain_vec_.size();
-        if (auto it = search(desired, index); 
-            it == std::end(chain_vec_[index]))
-        {
-            chain_vec_[index].emplace_front(desired, desired_value);
-            ++size_;
-            return true;
-        }
-        else
-        {
-            auto& [key, value] = *it;
-            value = desired_value;
-        }
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        size_t hash = hasher_(desired);
+        return emplace_hashed<true>(hash, std::move(desired),
+                                    std::move(desired_value));
+    }
 
-        return false;
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_hashed<false>(hasher_(desired), desired,
+                                     std::forward<Types>(args)...);
     }
 
-    virtual bool erase(const TKey& desired) override final
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
     {
-        size_t index = hasher_(desired) % chain_vec_.size();
-        if (auto it = search(desired, index); 
-            it != std::end(chain_vec_[index]))
-        {
-            chain_vec_[index].erase(it);
-            --size_;
-            return true;
-        }
+        size_t hash = hasher_(desired);
+        return emplace_hashed<false>(hash, std::move(desired),
+                                     std::forward<Types>(args)...);
+    }
 
-        return false;
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_hashed(hasher_(desired), desired);
     }
 
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<TValue>> 
         find(const TKey& desired) override final
     {
+        migrate_step();
+
         auto result = const_cast<const CChainHashTable&>(*this).find(desired);
 
         return (result ? 
@@ -109,60 +232,616 @@ public:
     virtual std::optional<std::reference_wrapper<const TValue>> 
         find(const TKey& desired) const override final
     {
-        size_t index = hasher_(desired) % chain_vec_.size();
-        if (auto it = search(desired, index); 
-            it != std::end(chain_vec_[index]))
+        return find_hashed(hasher_(desired), desired);
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_hashed(hasher_(desired), desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        migrate_step();
+
+        auto result = find_hashed(hasher_(desired), desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_hashed(hasher_(desired), desired);
+    }
+
+    virtual size_t insert_batch(const TKey* keys, const TValue* values,
+                                size_t count) override final
+    {
+        size_t result = 0u;
+        size_t hashes[NBatchGroup];
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
         {
-            auto& [key, value] = *it;
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group, hashes);
+
+            for (size_t index = 0u; index < group; ++index)
+                result += emplace_hashed<true>(hashes[index],
+                                               keys[begin + index],
+                                        values[begin + index]);
+        }
+
+        return result;
+    }
+
+    virtual size_t erase_batch(const TKey* keys,
+                               size_t count) override final
+    {
+        size_t result = 0u;
+        size_t hashes[NBatchGroup];
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
+        {
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group, hashes);
+
+            for (size_t index = 0u; index < group; ++index)
+                result += erase_hashed(hashes[index], keys[begin + index]);
+        }
+
+        return result;
+    }
+
+    // Lookups walk whole chains interleaved, see find_interleaved()
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<TValue>>* results
+            ) override final
+    {
+        migrate_steps(count);
+
+        return find_interleaved(keys, count, results);
+    }
+
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<const TValue>>* results
+            ) const override final
+    {
+        return find_interleaved(keys, count, results);
+    }
+
+protected:
+    using IHashTable<TK, TV>::NBatchGroup;
+    using IHashTable<TK, TV>::capacity_for;
+    using IHashTable<TK, TV>::prefetch;
+
+    // Link goes first as chain walk reads it together with the key
+    struct SNode
+    {
+        TIndex next;
+        TStorage data;
+    };
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_hashed(size_t hash, TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        migrate_step();
+
+        if (head_vec_.size() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
+            rehash(head_vec_.size() * NRehashFactor);
+
+        size_t index = bucket_of(hash);
+        if (TIndex node = search(desired, head_vec_[index]); node != NNil)
+        {
+            if constexpr (NAssign)
+                get_data_at(node).second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (is_migrating())
+        {
+            if (TIndex node =
+                    search(desired, old_head_vec_[old_bucket_of(hash)]);
+                node != NNil)
+            {
+                if constexpr (NAssign)
+                    get_data_at(node).second =
+                        (std::forward<Types>(args), ...);
+
+                return false;
+            }
+        }
+
+        TIndex node = allocate_node();
+        construct_at(node, std::piecewise_construct,
+                     std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                     std::forward_as_tuple(std::forward<Types>(args)...));
+        node_vec_[node].next = head_vec_[index];
+        head_vec_[index] = node;
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_hashed(size_t hash, const TKeyLike& desired)
+    {
+        migrate_step();
+
+        bool result =
+            unlink(desired, head_vec_[bucket_of(hash)]) ||
+            (is_migrating() &&
+             unlink(desired, old_head_vec_[old_bucket_of(hash)]));
+
+        if (result)
+            shrink_on_erase();
+
+        return result;
+    }
+
+    // Moves elements to the front of a pool of `count` nodes and rehashes
+    // into the least capacity that fits them if it is below the current
+    // one, returns whether it rehashed
+    bool shrink_to(size_t count)
+    {
+        if (count < node_vec_.size())
+            compact_pool(count);
+
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, NLoadRatio));
+        if (new_capacity >= head_vec_.size())
+            return false;
+
+        rehash(new_capacity);
+        return true;
+    }
+
+    inline void shrink_on_erase()
+    {
+        if constexpr (TShrink::NShrinkRatio != 0u)
+        {
+            if (size_ * TShrink::NShrinkRatio < head_vec_.size())
+                shrink_to(2u * size_);
+        }
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_hashed(size_t hash, const TKeyLike& desired) const
+    {
+        if (TIndex node = search(desired, head_vec_[bucket_of(hash)]);
+            node != NNil)
+        {
+            auto& [key, value] = get_data_at(node);
             return std::make_optional(std::cref(value));
         }
 
+        if (is_migrating())
+        {
+            if (TIndex node =
+                    search(desired, old_head_vec_[old_bucket_of(hash)]);
+                node != NNil)
+            {
+                auto& [key, value] = get_data_at(node);
+                return std::make_optional(std::cref(value));
+            }
+        }
+
         return std::nullopt;
     }
 
-protected:
+    // State of one lookup of find_interleaved(): it waits either for its
+    // bucket or for the node it is about to compare
+    struct SLookup
+    {
+        size_t position;
+        size_t hash;
+        TIndex node;
+        bool is_head;
+    };
+
+    // Keeps NInflight lookups going round-robin in the way of AMAC. Every
+    // lookup prefetches its next load and yields to the others, so each
+    // hop of every chain overlaps with hops of the other lookups instead of
+    // the first one only. Old buckets of incremental rehash are searched
+    // directly, as they exist only for a short while.
+    template<typename TResult>
+    size_t find_interleaved(const TKey* keys, size_t count,
+                            TResult* results) const
+    {
+        SLookup lookups[NInflight];
+        size_t active = 0u;
+        size_t next = 0u;
+        size_t result = 0u;
+
+        auto start = [this, keys](SLookup& lookup, size_t position) {
+                lookup = SLookup{ position, hasher_(keys[position]),
+                                  NNil, true };
+                prefetch(&head_vec_[bucket_of(lookup.hash)]);
+            };
+
+        auto finish = [this, keys, results, &result](const SLookup& lookup,
+                                                     TIndex node) {
+                const TKey& desired = keys[lookup.position];
+                if (node == NNil && is_migrating())
+                    node = search(desired,
+                                  old_head_vec_[old_bucket_of(lookup.hash)]);
+
+                if (node == NNil)
+                {
+                    results[lookup.position] = std::nullopt;
+                    return;
+                }
+
+                auto& [key, value] = get_data_at(node);
+                results[lookup.position] = typename TResult::value_type(
+                        const_cast<TValue&>(value));
+                ++result;
+            };
+
+        for (; active < NInflight && next < count; ++active, ++next)
+            start(lookups[active], next);
+
+        while (active > 0u)
+        {
+            for (size_t index = 0u; index < active; )
+            {
+                SLookup& lookup = lookups[index];
+
+                bool is_done = false;
+                if (lookup.is_head)
+                {
+                    lookup.node = head_vec_[bucket_of(lookup.hash)];
+                    lookup.is_head = false;
+                    is_done = (lookup.node == NNil);
+                }
+                else if (get_data_at(lookup.node).first ==
+                         keys[lookup.position])
+                {
+                    finish(lookup, lookup.node);
+                    is_done = true;
+                }
+                else
+                {
+                    lookup.node = node_vec_[lookup.node].next;
+                    is_done = (lookup.node == NNil);
+                }
+
+                if (!is_done)
+                {
+                    prefetch(&node_vec_[lookup.node]);
+                    ++index;
+                    continue;
+                }
+
+                if (lookup.node == NNil)
+                    finish(lookup, NNil);
+
+                // Finished slot takes the next key or the last lookup
+                if (next < count)
+                {
+                    start(lookup, next++);
+                    ++index;
+                }
+                else
+                    lookup = lookups[--active];
+            }
+        }
+
+        return result;
+    }
+
+    // Hashes a group of keys and prefetches their buckets, then the first
+    // node of every chain, as the node index is known only from its bucket
+    void prefetch_group(const TKey* keys, size_t count,
+                        size_t* hashes) const noexcept
+    {
+        for (size_t index = 0u; index < count; ++index)
+        {
+            hashes[index] = hasher_(keys[index]);
+            prefetch(&head_vec_[bucket_of(hashes[index])]);
+        }
+
+        for (size_t index = 0u; index < count; ++index)
+        {
+            if (TIndex head = head_vec_[bucket_of(hashes[index])];
+                head != NNil)
+                prefetch(&node_vec_[head]);
+        }
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(TIndex node, Types&&... args)
+    {
+        return new (&node_vec_[node].data)
+            TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(TIndex node)
+    {
+        get_data_at(node).~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(TIndex node) const noexcept
+    {
+        return const_cast<CChainHashTable*>(this)->get_data_at(node);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(TIndex node) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&node_vec_[node].data));
+    }
+
+    // Calls `func` for every node holding an element
+    template<typename TFunc>
+    void for_each_node(TFunc func)
+    {
+        for (const auto* heads : { &head_vec_, &old_head_vec_ })
+        {
+            for (TIndex head : *heads)
+            {
+                for (TIndex node = head; node != NNil; )
+                {
+                    TIndex next = node_vec_[node].next;
+                    func(node);
+                    node = next;
+                }
+            }
+        }
+    }
+
+    [[nodiscard]]
+    TIndex allocate_node()
+    {
+        if (free_head_ != NNil)
+        {
+            TIndex node = free_head_;
+            free_head_ = node_vec_[node].next;
+            return node;
+        }
+
+        if (node_count_ == node_vec_.size())
+            grow_pool(node_vec_.empty() ?
+                      NStartCapacity : node_vec_.size() * NRehashFactor);
+
+        return static_cast<TIndex>(node_count_++);
+    }
+
+    inline void release_node(TIndex node) noexcept
+    {
+        node_vec_[node].next = free_head_;
+        free_head_ = node;
+    }
+
+    // Nodes keep their indices, so links stay valid
+    void grow_pool(size_t new_size)
+    {
+        if (new_size > NNil)
+            throw std::length_error(
+                    "CChainHashTable::grow_pool(): "
+                    "too many nodes"
+                    );
+
+        auto new_node_vec = std::vector<SNode>(new_size);
+        for (TIndex node = 0u; node < node_count_; ++node)
+            new_node_vec[node].next = node_vec_[node].next;
+
+        for_each_node([this, &new_node_vec](TIndex node) {
+                new (&new_node_vec[node].data)
+                    TData{ std::move(get_data_at(node)) };
+                destruct_at(node);
+            });
+
+        node_vec_ = std::move(new_node_vec);
+    }
+
+    // Renumbers nodes in chain order into a pool of `new_size` nodes, which
+    // drops the free list
+    void compact_pool(size_t new_size)
+    {
+        auto new_node_vec = std::vector<SNode>(new_size);
+        TIndex new_node = 0u;
+        for (auto* heads : { &head_vec_, &old_head_vec_ })
+        {
+            for (TIndex& head : *heads)
+            {
+                TIndex* link = &head;
+                for (TIndex node = head; node != NNil; )
+                {
+                    TIndex next = node_vec_[node].next;
+                    new (&new_node_vec[new_node].data)
+                        TData{ std::move(get_data_at(node)) };
+                    destruct_at(node);
+
+                    *link = new_node;
+                    link = &new_node_vec[new_node].next;
+                    ++new_node;
+                    node = next;
+                }
+
+                *link = NNil;
+            }
+        }
+
+        node_vec_ = std::move(new_node_vec);
+        node_count_ = new_node;
+        free_head_ = NNil;
+    }
+
+    // Returns the node holding `desired` in the chain or NNil if none
+    template<typename TKeyLike>
+    [[nodiscard]]
+    TIndex search(const TKeyLike& desired, TIndex head) const noexcept
+    {
+        TIndex node = head;
+        while (node != NNil && !(get_data_at(node).first == desired))
+            node = node_vec_[node].next;
+
+        return node;
+    }
+
+    template<typename TKeyLike>
+    bool unlink(const TKeyLike& desired, TIndex& head)
+    {
+        for (TIndex* link = &head; *link != NNil;
+             link = &node_vec_[*link].next)
+        {
+            if (TIndex node = *link; get_data_at(node).first == desired)
+            {
+                *link = node_vec_[node].next;
+                destruct_at(node);
+                release_node(node);
+                --size_;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Moves every node of the chain to the head of its new chain
+    void relink(TIndex head)
+    {
+        for (TIndex node = head; node != NNil; )
+        {
+            TIndex next = node_vec_[node].next;
+            size_t index = index_of(get_data_at(node).first);
+
+            node_vec_[node].next = head_vec_[index];
+            head_vec_[index] = node;
+            node = next;
+        }
+    }
+
     void rehash(size_t new_capacity)
     {
-        if (new_capacity <= chain_vec_.size())
+        // Chains take any number of elements, so any capacity will do
+        if (new_capacity == 0u)
             throw std::invalid_argument(
                     "CChainHashTable::rehash(): "
-                    "new_capacity <= chain_vec_.size()"
+                    "new_capacity == 0"
                     );
 
-        auto old_chain_vec = std::vector<std::list<TData>>(new_capacity);
-        std::swap(chain_vec_, old_chain_vec);
+        complete_rehash();
 
-        size_ = 0u;
-        for (auto& chain : old_chain_vec)
+        auto old_head_vec = std::vector<TIndex>(new_capacity, NNil);
+        std::swap(head_vec_, old_head_vec);
+
+        if constexpr (TRehash::NMigrateStep != 0u)
         {
-            for (auto& [key, value] : chain)
-                insert(std::move(key), std::move(value));
+            old_head_vec_ = std::move(old_head_vec);
+            migrate_pos_ = 0u;
+            return;
         }
+
+        for (TIndex head : old_head_vec)
+            relink(head);
     }
 
-    auto search(const TKey& desired, size_t index) const
+    // Old buckets are kept only while incremental rehash is in progress
+    [[nodiscard]]
+    inline bool is_migrating() const noexcept
     {
-        return const_cast<CChainHashTable&>(*this).search(desired, index);
+        return TRehash::NMigrateStep != 0u && !old_head_vec_.empty();
     }
 
-    auto search(const TKey& desired, size_t index)
+    inline void migrate_step()
     {
-        return std::find_if(
-                std::begin(chain_vec_[index]), 
-                std::end(chain_vec_[index]), 
-                [&desired](const auto& elem) { 
-                    auto& [key, value] = elem;
-                    return key == desired; 
-                }
-            );
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep);
+    }
+
+    // Steps of `count` operations at once, so that elements found by
+    // a batch are not moved by its own later steps
+    inline void migrate_steps(size_t count)
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep * count);
+    }
+
+    inline void complete_rehash()
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(old_head_vec_.size());
+    }
+
+    // Relinks nodes of the next `count` old buckets
+    void migrate(size_t count)
+    {
+        if (!is_migrating())
+            return;
+
+        for (; count > 0u && migrate_pos_ < old_head_vec_.size();
+             --count, ++migrate_pos_)
+        {
+            relink(old_head_vec_[migrate_pos_]);
+            old_head_vec_[migrate_pos_] = NNil;
+        }
+
+        if (migrate_pos_ == old_head_vec_.size())
+        {
+            old_head_vec_ = std::vector<TIndex>();
+            migrate_pos_ = 0u;
+        }
+    }
+
+    [[nodiscard]]
+    inline size_t index_of(const TKey& desired) const noexcept
+    {
+        return bucket_of(hasher_(desired));
+    }
+
+    [[nodiscard]]
+    inline size_t bucket_of(size_t hash) const noexcept
+    {
+        return TCapacity::index(hash, head_vec_.size());
+    }
+
+    [[nodiscard]]
+    inline size_t old_bucket_of(size_t hash) const noexcept
+    {
+        return TCapacity::index(hash, old_head_vec_.size());
     }
 
 private:
     size_t size_{};
     THasher hasher_{};
 
-    // TODO: to replace std::list with custom array-based implementation
-    std::vector<std::list<TData>> chain_vec_{ NStartCapacity };
+    std::vector<TIndex> head_vec_ = std::vector<TIndex>(NStartCapacity, NNil);
+
+    // Node pool, erased nodes are chained into the free list
+    TIndex free_head_ = NNil;
+    size_t node_count_{};
+    std::vector<SNode> node_vec_{};
+
+    // Buckets being drained by incremental rehash
+    size_t migrate_pos_{};
+    std::vector<TIndex> old_head_vec_{};
 };
 
 } // namespace
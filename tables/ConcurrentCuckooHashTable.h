@@ -0,0 +1,879 @@
+#ifndef CONCURRENT_CUCKOO_HASHTABLE_H_
+#define CONCURRENT_CUCKOO_HASHTABLE_H_
+
+#include "ThreadIndex.h"
+
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <list>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Thread-safe cuckoo table over buckets of NSlots slots with lock striping
+// in the style of libcuckoo. Every bucket is guarded by one of NStripes
+// version counters: odd version means that the stripe is locked by
+// a writer. Readers of trivially copyable keys and values take no lock at
+// all, they copy the slots and retry if any version has changed meanwhile.
+//
+// Keys that find no eviction path in a sparse table go to an overflow list
+// guarded by its own mutex, which is searched only while it is not empty.
+//
+// Every operation announces the current epoch in its own slot, and a table
+// replaced by growth is freed once no operation may still be in an epoch
+// that could have seen it. Threads beyond NThreads running at once share
+// a counter instead, which holds off freeing while any of them runs.
+//
+// As values may change concurrently find() returns a copy, so the table
+// does not implement IHashTable.
+template<class TK, class TV,
+         class TLH = std::hash<TK>, class TRH = std::hash<TK>,
+         size_t NStripes = 1024u, size_t NThreads = 128u>
+class CConcurrentCuckooHashTable final
+{
+public:
+    using TKey = std::remove_cv_t<std::remove_reference_t<TK>>;
+    using TValue = TV;
+    using TLeftHasher = TLH;
+    using TRightHasher = TRH;
+
+    using TKeyStorage =
+        typename std::aligned_storage<sizeof(TKey), alignof(TKey)>::type;
+    using TValueStorage =
+        typename std::aligned_storage<sizeof(TValue), alignof(TValue)>::type;
+
+    static constexpr size_t NSlots = 4u;
+    static constexpr size_t NStartCapacity = NSlots * 2u;
+    // Growth above 80% load, evictions are rare and take every stripe
+    static constexpr size_t NLoadRatio = 5u;
+    static constexpr double NRehashFactor = 2.0;
+
+    // Bound on eviction path search, in buckets
+    static constexpr size_t NMaxPathNodes = 256u;
+    // A failed eviction grows the table only while it is at least
+    // 1/NSpillRatio full, see insert_exclusive()
+    static constexpr size_t NSpillRatio = 4u;
+
+    static constexpr bool NIsOptimistic =
+        std::is_trivially_copyable_v<TKey> &&
+        std::is_trivially_copyable_v<TValue>;
+
+    static_assert(NStripes > 0u && (NStripes & (NStripes - 1u)) == 0u,
+                  "stripe count must be a power of 2");
+
+    // Thread slot value of a thread outside of an operation
+    static constexpr uint64_t NEpochIdle = 0u;
+
+    CConcurrentCuckooHashTable():
+        table_(new STable(NStartCapacity / NSlots))
+    {}
+
+    CConcurrentCuckooHashTable(const CConcurrentCuckooHashTable&) = delete;
+    CConcurrentCuckooHashTable& operator = (
+            const CConcurrentCuckooHashTable&) = delete;
+
+    // Requires no operation to be running
+    ~CConcurrentCuckooHashTable()
+    {
+        STable* table = table_.load(std::memory_order_relaxed);
+        clear(table);
+
+        delete table;
+    }
+
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept
+    {
+        COpGuard guard(*this);
+        return (table_.load(std::memory_order_seq_cst)->mask + 1u) * NSlots;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return size() == 0u;
+    }
+
+    // Inserts or assigns, returns true if the key was not present
+    bool insert(const TKey& desired, const TValue& desired_value)
+    {
+        COpGuard op_guard(*this);
+        for (;;)
+        {
+            STable* table = table_.load(std::memory_order_seq_cst);
+            SPair buckets = buckets_of(table, desired);
+
+            CStripeGuard guard(*this, buckets);
+            if (table != table_.load(std::memory_order_relaxed))
+                continue;
+
+            if (SSlot found = search(table, buckets, desired); found.is_found)
+            {
+                get_value_at(table, found.bucket, found.slot) = desired_value;
+                return false;
+            }
+
+            if (assign_overflow(desired, desired_value))
+                return false;
+
+            size_t capacity = (table->mask + 1u) * NSlots;
+            if (capacity * (NLoadRatio - 1) <
+                (size_.load(std::memory_order_relaxed) + 1) * NLoadRatio)
+            {
+                guard.unlock();
+                grow(table);
+                continue;
+            }
+
+            // The less loaded bucket keeps both of them balanced
+            size_t first_free = free_slot(table, buckets.first);
+            size_t second_free = free_slot(table, buckets.second);
+            if (first_free != NSlots || second_free != NSlots)
+            {
+                bool is_first =
+                    (second_free == NSlots ||
+                     (first_free != NSlots && first_free <= second_free));
+                size_t bucket = (is_first ? buckets.first : buckets.second);
+                size_t slot = (is_first ? first_free : second_free);
+
+                construct_at(table, bucket, slot, desired, desired_value);
+                size_.fetch_add(1u, std::memory_order_relaxed);
+
+                return true;
+            }
+
+            guard.unlock();
+
+            CExclusiveGuard exclusive_guard(*this);
+            return insert_exclusive(desired, desired_value);
+        }
+    }
+
+    bool erase(const TKey& desired)
+    {
+        COpGuard op_guard(*this);
+        for (;;)
+        {
+            STable* table = table_.load(std::memory_order_seq_cst);
+            SPair buckets = buckets_of(table, desired);
+
+            CStripeGuard guard(*this, buckets);
+            if (table != table_.load(std::memory_order_relaxed))
+                continue;
+
+            SSlot found = search(table, buckets, desired);
+            if (!found.is_found)
+                return erase_overflow(desired);
+
+            destruct_at(table, found.bucket, found.slot);
+            size_.fetch_sub(1u, std::memory_order_relaxed);
+
+            return true;
+        }
+    }
+
+    [[nodiscard]]
+    std::optional<TValue> find(const TKey& desired) const
+    {
+        COpGuard op_guard(*this);
+        for (;;)
+        {
+            STable* table = table_.load(std::memory_order_seq_cst);
+            SPair buckets = buckets_of(table, desired);
+
+            if constexpr (NIsOptimistic)
+            {
+                size_t first_stripe = buckets.first & (NStripes - 1u);
+                size_t second_stripe = buckets.second & (NStripes - 1u);
+
+                uint64_t first_version = stripe_vec_[first_stripe].version
+                    .load(std::memory_order_acquire);
+                uint64_t second_version = stripe_vec_[second_stripe].version
+                    .load(std::memory_order_acquire);
+
+                if (((first_version | second_version) & 1u) != 0u)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                // Table swap happens under every lock, so versions read
+                // above would not match after it
+                if (table != table_.load(std::memory_order_acquire))
+                    continue;
+
+                std::optional<TValue> result =
+                    read_optimistic(table, buckets.first, desired);
+                if (!result)
+                    result = read_optimistic(table, buckets.second, desired);
+                if (!result)
+                    result = find_overflow(desired);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (stripe_vec_[first_stripe].version.load(
+                        std::memory_order_relaxed) == first_version &&
+                    stripe_vec_[second_stripe].version.load(
+                        std::memory_order_relaxed) == second_version)
+                    return result;
+            }
+            else
+            {
+                auto& self = const_cast<CConcurrentCuckooHashTable&>(*this);
+                CStripeGuard guard(self, buckets);
+                if (table != table_.load(std::memory_order_relaxed))
+                    continue;
+
+                if (SSlot found = search(table, buckets, desired);
+                    found.is_found)
+                    return get_value_at(table, found.bucket, found.slot);
+
+                return find_overflow(desired);
+            }
+        }
+    }
+
+protected:
+    struct SBucket
+    {
+        bool used[NSlots] = {};
+        TKeyStorage keys[NSlots];
+        TValueStorage values[NSlots];
+    };
+
+    struct STable
+    {
+        explicit STable(size_t bucket_count):
+            mask(bucket_count - 1u),
+            bucket_vec(bucket_count)
+        {}
+
+        size_t mask;
+        std::vector<SBucket> bucket_vec;
+    };
+
+    // Each stripe takes its own cache line, so locks do not false share
+    struct alignas(64) SStripe
+    {
+        std::atomic<uint64_t> version{};
+    };
+
+    struct SPair
+    {
+        size_t first;
+        size_t second;
+    };
+
+    struct SSlot
+    {
+        bool is_found;
+        size_t bucket;
+        size_t slot;
+    };
+
+    using TOverflowList = std::list<std::pair<TKey, TValue>>;
+
+    // Each slot takes its own cache line, so threads do not false share
+    struct alignas(64) SThread
+    {
+        std::atomic<uint64_t> epoch{ NEpochIdle };
+    };
+
+    struct SRetired
+    {
+        uint64_t epoch;
+        std::unique_ptr<STable> table;
+    };
+
+    // Announces the epoch before the operation loads the table. Store of
+    // the epoch and the table loads are all sequentially consistent, so
+    // either reclaim() sees the announcement or the operation sees the
+    // table that replaced a retired one.
+    class COpGuard
+    {
+    public:
+        explicit COpGuard(const CConcurrentCuckooHashTable& table) noexcept:
+            table_(table),
+            thread_(table.thread_slot())
+        {
+            if (thread_ != nullptr)
+                thread_->epoch.store(
+                        table_.epoch_.load(std::memory_order_acquire),
+                        std::memory_order_seq_cst);
+            else
+                table_.guests_.fetch_add(1u, std::memory_order_seq_cst);
+        }
+
+        COpGuard(const COpGuard&) = delete;
+        COpGuard& operator = (const COpGuard&) = delete;
+
+        ~COpGuard()
+        {
+            if (thread_ != nullptr)
+                thread_->epoch.store(NEpochIdle, std::memory_order_release);
+            else
+                table_.guests_.fetch_sub(1u, std::memory_order_release);
+        }
+
+    private:
+        const CConcurrentCuckooHashTable& table_;
+        SThread* thread_;
+    };
+
+    // Locks the stripes of both buckets in ascending order
+    class CStripeGuard
+    {
+    public:
+        CStripeGuard(CConcurrentCuckooHashTable& table, SPair buckets):
+            table_(table),
+            first_(std::min(buckets.first & (NStripes - 1u),
+                            buckets.second & (NStripes - 1u))),
+            second_(std::max(buckets.first & (NStripes - 1u),
+                             buckets.second & (NStripes - 1u)))
+        {
+            table_.lock(first_);
+            if (second_ != first_)
+                table_.lock(second_);
+        }
+
+        CStripeGuard(const CStripeGuard&) = delete;
+        CStripeGuard& operator = (const CStripeGuard&) = delete;
+
+        ~CStripeGuard()
+        {
+            unlock();
+        }
+
+        void unlock() noexcept
+        {
+            if (is_locked_)
+            {
+                if (second_ != first_)
+                    table_.unlock(second_);
+
+                table_.unlock(first_);
+                is_locked_ = false;
+            }
+        }
+
+    private:
+        CConcurrentCuckooHashTable& table_;
+        size_t first_;
+        size_t second_;
+        bool is_locked_ = true;
+    };
+
+    // Locks every stripe, which excludes all writers and locking readers
+    class CExclusiveGuard
+    {
+    public:
+        explicit CExclusiveGuard(CConcurrentCuckooHashTable& table):
+            table_(table)
+        {
+            for (size_t stripe = 0u; stripe < NStripes; ++stripe)
+                table_.lock(stripe);
+        }
+
+        CExclusiveGuard(const CExclusiveGuard&) = delete;
+        CExclusiveGuard& operator = (const CExclusiveGuard&) = delete;
+
+        ~CExclusiveGuard()
+        {
+            for (size_t stripe = NStripes; stripe > 0u; --stripe)
+                table_.unlock(stripe - 1u);
+        }
+
+    private:
+        CConcurrentCuckooHashTable& table_;
+    };
+
+    // Slot of the calling thread, the same in every table of this type;
+    // nullptr if all of them are taken by running threads
+    [[nodiscard]]
+    SThread* thread_slot() const noexcept
+    {
+        size_t index =
+            CThreadIndex<CConcurrentCuckooHashTable, NThreads>::get();
+
+        return (index < NThreads ? &thread_vec_[index] : nullptr);
+    }
+
+    void lock(size_t stripe) noexcept
+    {
+        auto& version = stripe_vec_[stripe].version;
+        for (;;)
+        {
+            uint64_t current = version.load(std::memory_order_relaxed);
+            if ((current & 1u) == 0u &&
+                version.compare_exchange_weak(current, current + 1u,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+                return;
+
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock(size_t stripe) noexcept
+    {
+        stripe_vec_[stripe].version.fetch_add(1u, std::memory_order_release);
+    }
+
+    // Right bucket is taken from the mixed hash, so buckets stay
+    // independent when both hashers are the same
+    [[nodiscard]]
+    SPair buckets_of(const STable* table, const TKey& desired) const noexcept
+    {
+        uint64_t hash = static_cast<uint64_t>(right_hasher_(desired));
+        hash ^= hash >> 33u;
+        hash *= 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 33u;
+
+        return SPair{ left_hasher_(desired) & table->mask,
+                      static_cast<size_t>(hash) & table->mask };
+    }
+
+    template<typename... Types>
+    static inline void construct_at(STable* table, size_t bucket,
+                                    size_t slot, const TKey& key,
+                                    Types&&... args)
+    {
+        SBucket& data = table->bucket_vec[bucket];
+        new (&data.keys[slot]) TKey(key);
+        new (&data.values[slot]) TValue(std::forward<Types>(args)...);
+        data.used[slot] = true;
+    }
+
+    static inline void destruct_at(STable* table, size_t bucket, size_t slot)
+    {
+        SBucket& data = table->bucket_vec[bucket];
+        get_key_at(table, bucket, slot).~TKey();
+        get_value_at(table, bucket, slot).~TValue();
+        data.used[slot] = false;
+    }
+
+    [[nodiscard]]
+    static inline TKey& get_key_at(STable* table, size_t bucket,
+                                   size_t slot) noexcept
+    {
+        return *std::launder(reinterpret_cast<TKey*>(
+                    &table->bucket_vec[bucket].keys[slot]));
+    }
+
+    [[nodiscard]]
+    static inline TValue& get_value_at(STable* table, size_t bucket,
+                                       size_t slot) noexcept
+    {
+        return *std::launder(reinterpret_cast<TValue*>(
+                    &table->bucket_vec[bucket].values[slot]));
+    }
+
+    [[nodiscard]]
+    static size_t free_slot(const STable* table, size_t bucket) noexcept
+    {
+        size_t slot = 0u;
+        while (slot < NSlots && table->bucket_vec[bucket].used[slot])
+            ++slot;
+
+        return slot;
+    }
+
+    // Requires stripes of both buckets to be locked
+    [[nodiscard]]
+    static SSlot search(STable* table, SPair buckets,
+                        const TKey& desired) noexcept
+    {
+        for (size_t bucket : { buckets.first, buckets.second })
+        {
+            for (size_t slot = 0u; slot < NSlots; ++slot)
+            {
+                if (table->bucket_vec[bucket].used[slot] &&
+                    get_key_at(table, bucket, slot) == desired)
+                    return SSlot{ true, bucket, slot };
+            }
+        }
+
+        return SSlot{ false, 0u, 0u };
+    }
+
+    // Copies slots that may be written at the same time; the copy is only
+    // used if stripe versions show that there was no writer
+    [[nodiscard]]
+    static std::optional<TValue> read_optimistic(const STable* table,
+                                                 size_t bucket,
+                                                 const TKey& desired) noexcept
+    {
+        const SBucket& data = table->bucket_vec[bucket];
+        for (size_t slot = 0u; slot < NSlots; ++slot)
+        {
+            bool used = false;
+            std::memcpy(&used, &data.used[slot], sizeof(bool));
+            if (!used)
+                continue;
+
+            TKeyStorage key;
+            std::memcpy(&key, &data.keys[slot], sizeof(TKey));
+            if (*std::launder(reinterpret_cast<TKey*>(&key)) == desired)
+            {
+                TValueStorage value;
+                std::memcpy(&value, &data.values[slot], sizeof(TValue));
+                return *std::launder(reinterpret_cast<TValue*>(&value));
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Every overflow helper requires stripes of the buckets of `desired` to
+    // be locked, so the key itself can not be moved meanwhile. The mutex
+    // guards the list against updates of other keys.
+    [[nodiscard]]
+    std::optional<TValue> find_overflow(const TKey& desired) const
+    {
+        if (overflow_size_.load(std::memory_order_acquire) == 0u)
+            return std::nullopt;
+
+        std::lock_guard lock(overflow_mutex_);
+        for (const auto& [key, value] : overflow_list_)
+        {
+            if (key == desired)
+                return value;
+        }
+
+        return std::nullopt;
+    }
+
+    bool assign_overflow(const TKey& desired, const TValue& desired_value)
+    {
+        if (overflow_size_.load(std::memory_order_acquire) == 0u)
+            return false;
+
+        std::lock_guard lock(overflow_mutex_);
+        for (auto& [key, value] : overflow_list_)
+        {
+            if (key == desired)
+            {
+                value = desired_value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool erase_overflow(const TKey& desired)
+    {
+        if (overflow_size_.load(std::memory_order_acquire) == 0u)
+            return false;
+
+        std::lock_guard lock(overflow_mutex_);
+        for (auto it = overflow_list_.begin(); it != overflow_list_.end();
+             ++it)
+        {
+            if (it->first == desired)
+            {
+                overflow_list_.erase(it);
+                overflow_size_.fetch_sub(1u, std::memory_order_release);
+                size_.fetch_sub(1u, std::memory_order_relaxed);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Requires every stripe to be locked
+    bool insert_exclusive(const TKey& desired, const TValue& desired_value)
+    {
+        STable* table = table_.load(std::memory_order_relaxed);
+        SPair buckets = buckets_of(table, desired);
+
+        if (SSlot found = search(table, buckets, desired); found.is_found)
+        {
+            get_value_at(table, found.bucket, found.slot) = desired_value;
+            return false;
+        }
+
+        if (assign_overflow(desired, desired_value))
+            return false;
+
+        // Keys that do not fit a sparse table share their buckets with
+        // many others, so growing would not help them
+        SSlot target = make_room(table, buckets);
+        while (!target.is_found)
+        {
+            if (is_sparse(table))
+            {
+                std::lock_guard lock(overflow_mutex_);
+                overflow_list_.emplace_back(desired, desired_value);
+                overflow_size_.fetch_add(1u, std::memory_order_release);
+                size_.fetch_add(1u, std::memory_order_relaxed);
+
+                return true;
+            }
+
+            rebuild(table->bucket_vec.size() * NRehashFactor);
+
+            table = table_.load(std::memory_order_relaxed);
+            buckets = buckets_of(table, desired);
+            target = make_room(table, buckets);
+        }
+
+        construct_at(table, target.bucket, target.slot,
+                     desired, desired_value);
+        size_.fetch_add(1u, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // Frees a slot in one of `buckets` by moving keys along the shortest
+    // eviction path found with breadth-first search over buckets. Requires
+    // every stripe to be locked.
+    [[nodiscard]]
+    SSlot make_room(STable* table, SPair buckets)
+    {
+        struct SPathNode
+        {
+            size_t bucket;
+            size_t parent;
+            // Slot of the parent bucket whose key moves to this bucket
+            size_t slot;
+        };
+
+        for (size_t bucket : { buckets.first, buckets.second })
+        {
+            if (size_t slot = free_slot(table, bucket); slot != NSlots)
+                return SSlot{ true, bucket, slot };
+        }
+
+        SPathNode path[NMaxPathNodes];
+        path[0u] = SPathNode{ buckets.first, NMaxPathNodes, 0u };
+        path[1u] = SPathNode{ buckets.second, NMaxPathNodes, 0u };
+
+        size_t tail = 2u;
+        for (size_t head = 0u; head < tail; ++head)
+        {
+            size_t bucket = path[head].bucket;
+            for (size_t slot = 0u; slot < NSlots; ++slot)
+            {
+                SPair key_buckets =
+                    buckets_of(table, get_key_at(table, bucket, slot));
+                size_t next_bucket = (key_buckets.first == bucket ?
+                                      key_buckets.second : key_buckets.first);
+
+                size_t free_index = free_slot(table, next_bucket);
+                if (free_index == NSlots)
+                {
+                    if (tail < NMaxPathNodes)
+                        path[tail++] = SPathNode{ next_bucket, head, slot };
+
+                    continue;
+                }
+
+                // Every key on the path moves one step towards the free slot
+                move_slot(table, bucket, slot, next_bucket, free_index);
+                free_index = slot;
+                for (size_t node = head; path[node].parent != NMaxPathNodes;
+                     node = path[node].parent)
+                {
+                    const SPathNode& parent = path[path[node].parent];
+                    move_slot(table, parent.bucket, path[node].slot,
+                              path[node].bucket, free_index);
+                    free_index = path[node].slot;
+                }
+
+                size_t root = head;
+                while (path[root].parent != NMaxPathNodes)
+                    root = path[root].parent;
+
+                return SSlot{ true, path[root].bucket, free_index };
+            }
+        }
+
+        return SSlot{ false, 0u, 0u };
+    }
+
+    static void move_slot(STable* table, size_t from_bucket, size_t from_slot,
+                          size_t to_bucket, size_t to_slot)
+    {
+        construct_at(table, to_bucket, to_slot,
+                     get_key_at(table, from_bucket, from_slot),
+                     std::move(get_value_at(table, from_bucket, from_slot)));
+        destruct_at(table, from_bucket, from_slot);
+    }
+
+    [[nodiscard]]
+    bool is_sparse(const STable* table) const noexcept
+    {
+        return (table->mask + 1u) * NSlots >
+               size_.load(std::memory_order_relaxed) * NSpillRatio;
+    }
+
+    void grow(STable* table)
+    {
+        CExclusiveGuard guard(*this);
+
+        // Somebody else may have grown the table meanwhile
+        if (table == table_.load(std::memory_order_relaxed))
+            rebuild(table->bucket_vec.size() * NRehashFactor);
+    }
+
+    // Copies every element, those of the overflow list included, to a new
+    // table with at least `bucket_count` buckets. The old table and list
+    // stay intact until the copy has succeeded, and the table grows again
+    // only while it is too dense to spill. Requires every stripe to be
+    // locked.
+    void rebuild(size_t bucket_count)
+    {
+        STable* old_table = table_.load(std::memory_order_relaxed);
+        for (;; bucket_count *= NRehashFactor)
+        {
+            auto new_table = std::make_unique<STable>(bucket_count);
+            TOverflowList new_overflow_list;
+            if (copy_all(old_table, new_table.get(), new_overflow_list))
+            {
+                clear(old_table);
+                {
+                    std::lock_guard lock(overflow_mutex_);
+                    overflow_size_.store(new_overflow_list.size(),
+                                         std::memory_order_release);
+                    std::swap(overflow_list_, new_overflow_list);
+                }
+
+                // Operations that announce a later epoch load the new
+                // table. Readers may still look at the old one, so it is
+                // only retired; its elements are already destroyed.
+                table_.store(new_table.release(), std::memory_order_seq_cst);
+                uint64_t epoch =
+                    epoch_.fetch_add(1u, std::memory_order_seq_cst);
+                retired_vec_.push_back(
+                        SRetired{ epoch, std::unique_ptr<STable>(old_table) });
+
+                reclaim();
+                return;
+            }
+
+            clear(new_table.get());
+        }
+    }
+
+    // Frees tables retired before the oldest epoch still announced.
+    // Requires every stripe to be locked.
+    void reclaim()
+    {
+        if (guests_.load(std::memory_order_seq_cst) != 0u)
+            return;
+
+        uint64_t min_epoch = epoch_.load(std::memory_order_seq_cst);
+        for (const SThread& thread : thread_vec_)
+        {
+            uint64_t epoch = thread.epoch.load(std::memory_order_seq_cst);
+            if (epoch != NEpochIdle && epoch < min_epoch)
+                min_epoch = epoch;
+        }
+
+        size_t kept = 0u;
+        for (SRetired& retired : retired_vec_)
+        {
+            if (retired.epoch >= min_epoch)
+                retired_vec_[kept++] = std::move(retired);
+        }
+
+        retired_vec_.resize(kept);
+    }
+
+    [[nodiscard]]
+    bool copy_all(STable* from, STable* to, TOverflowList& to_overflow_list)
+    {
+        for (size_t bucket = 0u; bucket <= from->mask; ++bucket)
+        {
+            for (size_t slot = 0u; slot < NSlots; ++slot)
+            {
+                if (from->bucket_vec[bucket].used[slot] &&
+                    !copy_one(to, to_overflow_list,
+                              get_key_at(from, bucket, slot),
+                              get_value_at(from, bucket, slot)))
+                    return false;
+            }
+        }
+
+        for (const auto& [key, value] : overflow_list_)
+        {
+            if (!copy_one(to, to_overflow_list, key, value))
+                return false;
+        }
+
+        return true;
+    }
+
+    [[nodiscard]]
+    bool copy_one(STable* to, TOverflowList& to_overflow_list,
+                  const TKey& key, const TValue& value)
+    {
+        if (SSlot target = make_room(to, buckets_of(to, key));
+            target.is_found)
+        {
+            construct_at(to, target.bucket, target.slot, key, value);
+            return true;
+        }
+
+        if (!is_sparse(to))
+            return false;
+
+        to_overflow_list.emplace_back(key, value);
+        return true;
+    }
+
+    static void clear(STable* table)
+    {
+        for (size_t bucket = 0u; bucket <= table->mask; ++bucket)
+        {
+            for (size_t slot = 0u; slot < NSlots; ++slot)
+            {
+                if (table->bucket_vec[bucket].used[slot])
+                    destruct_at(table, bucket, slot);
+            }
+        }
+    }
+
+private:
+    std::atomic<size_t> size_{};
+
+    TLeftHasher left_hasher_{};
+    TRightHasher right_hasher_{};
+
+    std::atomic<STable*> table_;
+    std::vector<SStripe> stripe_vec_ = std::vector<SStripe>(NStripes);
+
+    mutable std::mutex overflow_mutex_{};
+    TOverflowList overflow_list_{};
+    std::atomic<size_t> overflow_size_{};
+
+    // Retired tables are changed only under every stripe lock
+    std::atomic<uint64_t> epoch_{ NEpochIdle + 1u };
+    mutable std::vector<SThread> thread_vec_ =
+        std::vector<SThread>(NThreads);
+    mutable std::atomic<size_t> guests_{};
+    std::vector<SRetired> retired_vec_{};
+};
+
+} // namespace
+
+#endif // CONCURRENT_CUCKOO_HASHTABLE_H_
@@ -2,41 +2,67 @@
 #define CUCKOO_HASHTABLE_H_
 
 #include "IHashTable.h"
+#include "CapacityPolicy.h"
+#include "RehashPolicy.h"
+#include "ShrinkPolicy.h"
 
 #include <iostream>
 
+#include <algorithm>
+#include <list>
 #include <utility>
 #include <optional>
 #include <functional>
 #include <stdexcept>
-#include <random>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
 
 namespace {
 
 template<class TK, class TV, 
-         class TLH = std::hash<TK>, class TRH = std::hash<TK>>
+         class TLH = std::hash<TK>, class TRH = std::hash<TK>,
+         class TC = CPow2Capacity, class TR = CFullRehash,
+         class TS = CNoShrink>
 class CCuckooHashTable final : public IHashTable<TK, TV>
 {
 public:
     using typename IHashTable<TK, TV>::TKey;
     using typename IHashTable<TK, TV>::TValue;
     using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
     using TLeftHasher = TLH;
     using TRightHasher = TRH;
+    using TCapacity = TC;
+    using TRehash = TR;
+    using TShrink = TS;
 
     static constexpr size_t NStartCapacity = 1u;
     static constexpr size_t NLoadRatio = 2u;
     static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent =
+        SIsTransparent<TLeftHasher>::value &&
+        SIsTransparent<TRightHasher>::value;
 
     using TStorage = 
         typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
 
+    // Elements that found no eviction path wait here until the table grows
+    static constexpr size_t NStashSize = 4u;
+    // Bound on eviction path search, both candidate chains together
+    static constexpr size_t NMaxPathNodes = 64u;
+    // A full stash grows the table only while it is at least
+    // 1/NSpillRatio full, see insert_core()
+    static constexpr size_t NSpillRatio = 4u;
+
     CCuckooHashTable() = default;
 
     template<typename TIter>
     CCuckooHashTable(TIter begin_it, TIter end_it):
         CCuckooHashTable()
     {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
         for (TIter iter = begin_it; iter != end_it; ++iter)
         {
             const auto& [key, value] = *iter;
@@ -44,6 +70,62 @@ public:
         }
     }
 
+    CCuckooHashTable(const CCuckooHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        left_hasher_(other.left_hasher_),
+        right_hasher_(other.right_hasher_),
+        used_vec_(other.used_vec_),
+        data_vec_(other.data_vec_.size()),
+        stash_used_vec_(other.stash_used_vec_),
+        overflow_list_(other.overflow_list_),
+        migrate_pos_(other.migrate_pos_),
+        old_used_vec_(other.old_used_vec_),
+        old_data_vec_(other.old_data_vec_.size())
+    {
+        for (size_t index = 0u; index < used_vec_.size(); ++index)
+        {
+            if (used_vec_[index])
+                construct_at(index, other.get_data_at(index));
+        }
+
+        for (size_t index = 0u; index < old_data_vec_.size(); ++index)
+        {
+            if (old_used_vec_[index])
+                new (&old_data_vec_[index]) TData{
+                    other.get_old_data_at(index) };
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (stash_used_vec_[index])
+                new (&stash_vec_[index]) TData{ other.get_stash_at(index) };
+        }
+    }
+
+    CCuckooHashTable& operator = (const CCuckooHashTable& other)
+    {
+        if (this != &other)
+        {
+            CCuckooHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CCuckooHashTable(CCuckooHashTable&& other) noexcept:
+        CCuckooHashTable()
+    {
+        swap(other);
+    }
+
+    CCuckooHashTable& operator = (CCuckooHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
     virtual ~CCuckooHashTable() final
     {
         size_t cap = capacity();
@@ -52,6 +134,33 @@ public:
             if (used_vec_[index])
                 destruct_at(index);
         }
+
+        for (size_t index = 0u; index < old_data_vec_.size(); ++index)
+        {
+            if (old_used_vec_[index])
+                get_old_data_at(index).~TData();
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (stash_used_vec_[index])
+                get_stash_at(index).~TData();
+        }
+    }
+
+    void swap(CCuckooHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(left_hasher_, other.left_hasher_);
+        std::swap(right_hasher_, other.right_hasher_);
+        std::swap(used_vec_, other.used_vec_);
+        std::swap(data_vec_, other.data_vec_);
+        std::swap(stash_used_vec_, other.stash_used_vec_);
+        std::swap(stash_vec_, other.stash_vec_);
+        std::swap(overflow_list_, other.overflow_list_);
+        std::swap(migrate_pos_, other.migrate_pos_);
+        std::swap(old_used_vec_, other.old_used_vec_);
+        std::swap(old_data_vec_, other.old_data_vec_);
     }
 
     [[nodiscard]]
@@ -72,113 +181,269 @@ public:
         return size_ == 0u;
     }
 
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, get_load_ratio()));
+        if (new_capacity > capacity())
+        {
+            rehash(new_capacity);
+            complete_rehash();
+        }
+    }
+
+    virtual void shrink_to_fit() override final
+    {
+        complete_rehash();
+
+        if (shrink_to(size_))
+            complete_rehash();
+    }
+
     virtual bool insert(const TKey& desired, 
                         const TValue& desired_value) override final
     {
-        thread_local bool is_in_rehash = false;
-        TStorage buffer[2u] = {};
+        return emplace_core<true>(desired, desired_value);
+    }
 
-        size_t ratio = get_load_ratio();
-        if (capacity() * (ratio - 1) < (size_ + 1) * ratio)
-            rehash(capacity() * NRehashFactor);
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
 
-        if (size_t left_index = left_pos(desired); used_vec_[left_index])
-        {
-            if (auto& [key, value] = get_data_at(left_index); key == desired)
-            {
-                value = desired_value;
-                return false;
-            }
-        }
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
 
-        if (size_t right_index = right_pos(desired); used_vec_[right_index])
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    // Lookups by any type both hashers accept, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        migrate_step();
+
+        if (TData* data = search(desired); data != nullptr)
+            return std::ref(data->second);
+
+        return std::nullopt;
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        if (const TData* data =
+                const_cast<CCuckooHashTable&>(*this).search(desired);
+            data != nullptr)
+            return std::cref(data->second);
+
+        return std::nullopt;
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>> 
+        find(const TKey& desired) const override final
+    {
+        if (const TData* data =
+                const_cast<CCuckooHashTable&>(*this).search(desired);
+            data != nullptr)
+            return std::cref(data->second);
+
+        return std::nullopt;
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>> 
+        find(const TKey& desired) override final
+    {
+        migrate_step();
+
+        if (TData* data = search(desired); data != nullptr)
+            return std::ref(data->second);
+
+        return std::nullopt;
+    }
+
+    virtual size_t insert_batch(const TKey* keys, const TValue* values,
+                                size_t count) override final
+    {
+        size_t result = 0u;
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
         {
-            if (auto& [key, value] = get_data_at(right_index); key == desired)
-            {
-                value = desired_value;
-                return false;
-            }
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group);
+
+            for (size_t index = begin; index < begin + group; ++index)
+                result += insert(keys[index], values[index]);
         }
 
-        TStorage* storage = buffer;
-        TStorage* tmp_storage = buffer + 1u;
-        new (storage) TData{ desired, desired_value };
+        return result;
+    }
 
-        bool is_left = true;
-        size_t base_index = left_pos(desired);
-        if (used_vec_[base_index])
+    virtual size_t erase_batch(const TKey* keys,
+                               size_t count) override final
+    {
+        size_t result = 0u;
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
         {
-            base_index = right_pos(desired);
-            is_left = false;
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group);
+
+            for (size_t index = begin; index < begin + group; ++index)
+                result += erase(keys[index]);
         }
 
-        size_t cur_index = base_index;
+        return result;
+    }
 
-        for (size_t count = 0u; (count * 2u) < capacity(); 
-             (is_left = !is_left), ++count)
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<TValue>>* results
+            ) override final
+    {
+        migrate_steps(count);
+
+        size_t result = 0u;
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
         {
-            auto& [key, value] = 
-                *std::launder(reinterpret_cast<TData*>(storage));
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group);
 
-            if (!used_vec_[cur_index])
+            for (size_t index = begin; index < begin + group; ++index)
             {
-                construct_at(cur_index, key, std::move(value));
-                used_vec_[cur_index] = true;
-                std::launder(reinterpret_cast<TData*>(storage))->~TData();
-                ++size_;
-
-                return true;
+                TData* data = search(keys[index]);
+                results[index] = (data != nullptr ?
+                                  std::make_optional(std::ref(data->second)) :
+                                  std::nullopt);
+                result += (data != nullptr);
             }
+        }
 
-            auto& [tmp_key, tmp_value] = get_data_at(cur_index);
-            size_t next_index = 
-                (is_left ? right_pos(tmp_key) : left_pos(tmp_key));
+        return result;
+    }
 
-            new (tmp_storage) TData{ tmp_key, std::move(tmp_value) };
-            destruct_at(cur_index);
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<const TValue>>* results
+            ) const override final
+    {
+        size_t result = 0u;
+        for (size_t begin = 0u; begin < count; begin += NBatchGroup)
+        {
+            size_t group = std::min(NBatchGroup, count - begin);
+            prefetch_group(keys + begin, group);
 
-            construct_at(cur_index, key, std::move(value));
-            std::launder(reinterpret_cast<TData*>(storage))->~TData();
+            for (size_t index = begin; index < begin + group; ++index)
+            {
+                results[index] = find(keys[index]);
+                result += results[index].has_value();
+            }
+        }
 
-            std::swap(storage, tmp_storage);
+        return result;
+    }
 
-            if (next_index == base_index)
-                break;
+protected:
+    // Layout of mapped files reads the storage directly
+    template<class> friend class CCuckooLayout;
 
-            cur_index = next_index;
-        }
+    using IHashTable<TK, TV>::NBatchGroup;
+    using IHashTable<TK, TV>::capacity_for;
+    using IHashTable<TK, TV>::prefetch;
 
-        base_index = 0u;
-        while (base_index < data_vec_.size())
+    // Both slots of every key are fetched at once. Keys are hashed again
+    // when resolved, which is cheap next to a cache miss.
+    void prefetch_group(const TKey* keys, size_t count) const noexcept
+    {
+        for (size_t index = 0u; index < count; ++index)
         {
-            if (!used_vec_[base_index])
-                break;
-
-            ++base_index;
+            prefetch(&data_vec_[left_pos(keys[index])]);
+            prefetch(&data_vec_[right_pos(keys[index])]);
         }
+    }
 
-        auto& [key, value] = 
-            *std::launder(reinterpret_cast<TData*>(storage));
-        construct_at(base_index, key, std::move(value));
-        used_vec_[base_index] = true;
-        ++size_;
-        std::launder(reinterpret_cast<TData*>(storage))->~TData();
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
 
-        if (!is_in_rehash)
+        migrate_step();
+
+        size_t ratio = get_load_ratio();
+        if (capacity() * (ratio - 1) < (size_ + 1) * ratio)
         {
-            is_in_rehash = true;
-            rehash();
-            is_in_rehash = false;
+            complete_rehash();
+            rehash(capacity() * NRehashFactor);
         }
-        else
+
+        if (TData* data = search(desired); data != nullptr)
         {
-            rehash(capacity() * 2u);
+            if constexpr (NAssign)
+                data->second = (std::forward<Types>(args), ...);
+
+            return false;
         }
 
+        insert_core(std::forward<TKeyArg>(desired),
+                    std::forward<Types>(args)...);
+
         return true;
     }
 
-    virtual bool erase(const TKey& desired) override final
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        migrate_step();
+
+        bool result = remove_core(desired);
+        if (result)
+            shrink_on_erase();
+
+        return result;
+    }
+
+    template<typename TKeyLike>
+    bool remove_core(const TKeyLike& desired)
     {
         if (size_t left_index = left_pos(desired); used_vec_[left_index])
         {
@@ -204,42 +469,168 @@ public:
             }
         }
 
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (!stash_used_vec_[index])
+                continue;
+
+            if (auto& [key, value] = get_stash_at(index); key == desired)
+            {
+                get_stash_at(index).~TData();
+                stash_used_vec_[index] = false;
+                --size_;
+
+                return true;
+            }
+        }
+
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+        {
+            overflow_list_.erase(found);
+            --size_;
+
+            return true;
+        }
+
+        if (!is_migrating())
+            return false;
+
+        for (size_t old_index : { old_left_pos(desired),
+                                  old_right_pos(desired) })
+        {
+            if (!old_used_vec_[old_index])
+                continue;
+
+            if (auto& [key, value] = get_old_data_at(old_index);
+                key == desired)
+            {
+                get_old_data_at(old_index).~TData();
+                old_used_vec_[old_index] = false;
+                --size_;
+
+                return true;
+            }
+        }
+
         return false;
     }
 
-    [[nodiscard]]
-    virtual std::optional<std::reference_wrapper<const TValue>> 
-        find(const TKey& desired) const override final
+
+    // Puts a key known to be absent, evicting others along the way. Only
+    // growth costs more than a bounded amount of work. Keys that fit
+    // neither a sparse table nor the stash share their slots with many
+    // others, so they go to the overflow list instead of growing the table
+    // without bound.
+    template<typename TKeyArg, typename... Types>
+    void insert_core(TKeyArg&& desired, Types&&... args)
     {
-        auto result = const_cast<CCuckooHashTable&>(*this).find(desired);
+        for (;;)
+        {
+            if (size_t target = make_room(desired);
+                target != data_vec_.size())
+            {
+                construct_at(target, std::piecewise_construct,
+                             std::forward_as_tuple(
+                                 std::forward<TKeyArg>(desired)),
+                             std::forward_as_tuple(
+                                 std::forward<Types>(args)...));
+                used_vec_[target] = true;
+                ++size_;
+
+                return;
+            }
+
+            for (size_t index = 0u; index < NStashSize; ++index)
+            {
+                if (!stash_used_vec_[index])
+                {
+                    new (&stash_vec_[index]) TData{
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                        std::forward_as_tuple(std::forward<Types>(args)...) };
+                    stash_used_vec_[index] = true;
+                    ++size_;
+
+                    return;
+                }
+            }
+
+            if (capacity() > size_ * NSpillRatio)
+            {
+                overflow_list_.emplace_back(
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                        std::forward_as_tuple(std::forward<Types>(args)...));
+                ++size_;
 
-        return (result ? 
-                std::make_optional(
-                        std::cref(const_cast<TValue&>(result.value().get()))
-                    ) : 
-                std::nullopt);
+                return;
+            }
+
+            grow(capacity() * NRehashFactor);
+        }
     }
 
+    // Frees one of the two slots of `desired` by moving keys along the
+    // shortest eviction path found with breadth-first search. Returns the
+    // freed slot or data_vec_.size() if there is no short enough path.
+    template<typename TKeyLike>
     [[nodiscard]]
-    virtual std::optional<std::reference_wrapper<TValue>> 
-        find(const TKey& desired) override final
+    size_t make_room(const TKeyLike& desired)
     {
-        if (size_t left_index = left_pos(desired); used_vec_[left_index])
+        struct SPathNode
         {
-            if (auto& [key, value] = get_data_at(left_index); key == desired)
-                return std::ref(value);
-        }
+            size_t index;
+            size_t parent;
+        };
 
-        if (size_t right_index = right_pos(desired); used_vec_[right_index])
+        size_t left_index = left_pos(desired);
+        if (!used_vec_[left_index])
+            return left_index;
+
+        size_t right_index = right_pos(desired);
+        if (!used_vec_[right_index])
+            return right_index;
+
+        SPathNode path[NMaxPathNodes];
+        path[0u] = SPathNode{ left_index, NMaxPathNodes };
+        path[1u] = SPathNode{ right_index, NMaxPathNodes };
+
+        size_t tail = 2u;
+        for (size_t head = 0u; head < tail; ++head)
         {
-            if (auto& [key, value] = get_data_at(right_index); key == desired)
-                return std::ref(value);
+            size_t index = path[head].index;
+            const TKey& key = get_data_at(index).first;
+            size_t next_index =
+                (index < capacity() ? right_pos(key) : left_pos(key));
+
+            if (used_vec_[next_index])
+            {
+                if (tail < NMaxPathNodes)
+                    path[tail++] = SPathNode{ next_index, head };
+
+                continue;
+            }
+
+            // Every key on the path moves one step towards the free slot
+            used_vec_[next_index] = true;
+            for (size_t node = head; node != NMaxPathNodes;
+                 node = path[node].parent)
+            {
+                construct_at(next_index,
+                             std::move(get_data_at(path[node].index)));
+                destruct_at(path[node].index);
+                next_index = path[node].index;
+            }
+
+            used_vec_[next_index] = false;
+
+            return next_index;
         }
 
-        return std::nullopt;
+        return data_vec_.size();
     }
 
-protected:
     template<typename... Types>
     inline TData* construct_at(size_t idx, Types&&... args)
     {
@@ -264,110 +655,344 @@ protected:
     }
 
     [[nodiscard]]
-    inline size_t left_pos(const TKey& desired) const noexcept
+    inline TData& get_stash_at(size_t idx) noexcept
     {
-        return (left_hasher_(desired) ^ left_xor_) % capacity();
+        return *std::launder(reinterpret_cast<TData*>(&stash_vec_[idx]));
     }
 
     [[nodiscard]]
-    inline size_t right_pos(const TKey& desired) const noexcept
+    inline const TData& get_stash_at(size_t idx) const noexcept
     {
-        return (right_hasher_(desired) ^ right_xor_) % capacity() + capacity();
+        return const_cast<CCuckooHashTable*>(this)->get_stash_at(idx);
     }
 
     [[nodiscard]]
-    inline size_t get_load_ratio() const noexcept
+    inline TData& get_old_data_at(size_t idx) noexcept
     {
-        return NLoadRatio;
+        return *std::launder(reinterpret_cast<TData*>(&old_data_vec_[idx]));
     }
 
-    void rehash()
+    [[nodiscard]]
+    inline const TData& get_old_data_at(size_t idx) const noexcept
     {
-        thread_local std::random_device seed_dev;
-        thread_local std::mt19937 rand_gen(seed_dev());
+        return const_cast<CCuckooHashTable*>(this)->get_old_data_at(idx);
+    }
 
-        TStorage buffer;
-        TStorage* storage = &buffer;
+    // Returns the element with `desired` key from either storage or nullptr
+    template<typename TKeyLike>
+    [[nodiscard]]
+    TData* search(const TKeyLike& desired) noexcept
+    {
+        if (size_t left_index = left_pos(desired); used_vec_[left_index])
+        {
+            if (auto& data = get_data_at(left_index); data.first == desired)
+                return &data;
+        }
 
-        left_xor_ = rand_gen();
-        right_xor_ = rand_gen();
+        if (size_t right_index = right_pos(desired); used_vec_[right_index])
+        {
+            if (auto& data = get_data_at(right_index); data.first == desired)
+                return &data;
+        }
 
-        size_t cap = capacity();
-        for (size_t index = 0u; index < cap; ++index)
+        for (size_t index = 0u; index < NStashSize; ++index)
         {
-            if (used_vec_[index])
+            if (stash_used_vec_[index])
             {
-                if (auto& [key_ref, value_ref] = get_data_at(index);
-                    left_pos(key_ref) != index)
-                {
-                    auto& [key, value] = *std::launder(reinterpret_cast<TData*>
-                            (new (storage) TData{ key_ref, value_ref }));
+                if (auto& data = get_stash_at(index); data.first == desired)
+                    return &data;
+            }
+        }
 
-                    destruct_at(index);
-                    used_vec_[index] = false;
-                    --size_;
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+            return &*found;
 
-                    insert(key, std::move(value));
-                    std::launder(reinterpret_cast<TData*>(storage))->~TData();
-                }
-            }
+        if (!is_migrating())
+            return nullptr;
 
-            if (used_vec_[index + cap])
-            {
-                if (auto& [key_ref, value_ref] = get_data_at(index + cap);
-                    right_pos(key_ref) != index + cap)
-                {
-                    auto& [key, value] = *std::launder(reinterpret_cast<TData*>
-                            (new (storage) TData{ key_ref, value_ref }));
+        for (size_t old_index : { old_left_pos(desired),
+                                  old_right_pos(desired) })
+        {
+            if (!old_used_vec_[old_index])
+                continue;
 
-                    destruct_at(index + cap);
-                    used_vec_[index + cap] = false;
-                    --size_;
+            if (auto& data = get_old_data_at(old_index);
+                data.first == desired)
+                return &data;
+        }
 
-                    insert(key, std::move(value));
-                    std::launder(reinterpret_cast<TData*>(storage))->~TData();
-                }
-            }
+        return nullptr;
+    }
+
+    // Holds only keys that fit neither their slots nor the stash, so it is
+    // empty unless the hashers map many keys to the same slots
+    template<typename TKeyLike>
+    [[nodiscard]]
+    typename std::list<TData>::iterator
+        search_overflow(const TKeyLike& desired)
+    {
+        return std::find_if(overflow_list_.begin(), overflow_list_.end(),
+                            [&desired](const TData& data)
+                            { return data.first == desired; });
+    }
+
+    // Spreads high bits over low ones, so slots stay independent when both
+    // hashers are the same: without it the pair of slots of a key would
+    // depend on the same low bits and eviction paths would be short cycles
+    [[nodiscard]]
+    static inline size_t mix(size_t hash) noexcept
+    {
+        uint64_t result = static_cast<uint64_t>(hash);
+        result ^= result >> 33u;
+        result *= 0xFF51AFD7ED558CCDu;
+        result ^= result >> 33u;
+
+        return static_cast<size_t>(result);
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline size_t left_pos(const TKeyLike& desired) const noexcept
+    {
+        return TCapacity::index(left_hasher_(desired),
+                                capacity());
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline size_t right_pos(const TKeyLike& desired) const noexcept
+    {
+        return TCapacity::index(mix(right_hasher_(desired)),
+                                capacity()) + capacity();
+    }
+
+    [[nodiscard]]
+    inline size_t old_capacity() const noexcept
+    {
+        return old_data_vec_.size() / 2u;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline size_t old_left_pos(const TKeyLike& desired) const noexcept
+    {
+        return TCapacity::index(left_hasher_(desired),
+                                old_capacity());
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline size_t old_right_pos(const TKeyLike& desired) const noexcept
+    {
+        return TCapacity::index(mix(right_hasher_(desired)),
+                                old_capacity()) + old_capacity();
+    }
+
+    // Old storage is kept only while incremental rehash is in progress
+    [[nodiscard]]
+    inline bool is_migrating() const noexcept
+    {
+        return TRehash::NMigrateStep != 0u && !old_data_vec_.empty();
+    }
+
+    inline void migrate_step()
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep);
+    }
+
+    // Steps of `count` operations at once, so that elements found by
+    // a batch are not moved by its own later steps
+    inline void migrate_steps(size_t count)
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep * count);
+    }
+
+    inline void complete_rehash()
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(old_data_vec_.size());
+    }
+
+    void migrate(size_t count)
+    {
+        if (!is_migrating())
+            return;
+
+        TStorage buffer;
+        for (; count > 0u && migrate_pos_ < old_data_vec_.size();
+             --count, ++migrate_pos_)
+        {
+            if (!old_used_vec_[migrate_pos_])
+                continue;
+
+            // Slot is released first, so growth on a full stash never
+            // sees the element twice
+            auto& [key, value] = *new (&buffer) TData{
+                std::move(get_old_data_at(migrate_pos_)) };
+            get_old_data_at(migrate_pos_).~TData();
+            old_used_vec_[migrate_pos_] = false;
+            --size_;
+
+            insert_core(key, std::move(value));
+            std::launder(reinterpret_cast<TData*>(&buffer))->~TData();
+        }
+
+        if (migrate_pos_ == old_data_vec_.size())
+        {
+            old_used_vec_ = std::vector<bool>();
+            old_data_vec_ = std::vector<TStorage>();
+            migrate_pos_ = 0u;
         }
     }
 
+    [[nodiscard]]
+    inline size_t get_load_ratio() const noexcept
+    {
+        return NLoadRatio;
+    }
+
     void rehash(size_t new_capacity)
     {
-        size_t old_capacity = capacity();
-        if (new_capacity <= old_capacity)
+        // Eviction failures grow the table again, so any capacity will do
+        if (new_capacity == 0u)
             throw std::invalid_argument(
                     "CCuckooHashTable::rehash(): "
-                    "new_capacity <= old_capacity"
+                    "new_capacity == 0"
                     );
 
-        auto new_data_vec = std::vector<TStorage>(new_capacity * 2u);
-        for (size_t index = 0u; index < old_capacity * 2u; ++index)
+        complete_rehash();
+
+        if constexpr (TRehash::NMigrateStep != 0u)
         {
-            if (used_vec_[index])
+            old_used_vec_ = std::vector<bool>(new_capacity * 2u, false);
+            old_data_vec_ = std::vector<TStorage>(new_capacity * 2u);
+            std::swap(used_vec_, old_used_vec_);
+            std::swap(data_vec_, old_data_vec_);
+            migrate_pos_ = 0u;
+
+            // Stash belongs to the new storage, and there is room for it
+            drain_stash();
+            drain_overflow();
+
+            return;
+        }
+
+        grow(new_capacity);
+    }
+
+    // Rehashes into the least capacity that fits `count` elements if it is
+    // below the current one, returns whether it did
+    bool shrink_to(size_t count)
+    {
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, get_load_ratio()));
+        if (new_capacity >= capacity())
+            return false;
+
+        rehash(new_capacity);
+        return true;
+    }
+
+    inline void shrink_on_erase()
+    {
+        if constexpr (TShrink::NShrinkRatio != 0u)
+        {
+            if (size_ * TShrink::NShrinkRatio < capacity())
+                shrink_to(2u * size_);
+        }
+    }
+
+    // Moves stash elements back to the table after it has grown
+    void drain_stash()
+    {
+        TStorage buffer;
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (!stash_used_vec_[index])
+                continue;
+
+            // Stash slot is released first, so it is never full here
+            auto& [key, value] = *new (&buffer) TData{
+                std::move(get_stash_at(index)) };
+            get_stash_at(index).~TData();
+            stash_used_vec_[index] = false;
+            --size_;
+
+            insert_core(key, std::move(value));
+            std::launder(reinterpret_cast<TData*>(&buffer))->~TData();
+        }
+    }
+
+    // Moves overflow elements back to the table after it has grown. Those
+    // that still do not fit end up in the overflow list again.
+    void drain_overflow()
+    {
+        std::list<TData> old_overflow_list;
+        std::swap(overflow_list_, old_overflow_list);
+
+        for (; !old_overflow_list.empty(); old_overflow_list.pop_front())
+        {
+            auto& [key, value] = old_overflow_list.front();
+            --size_;
+
+            insert_core(std::move(key), std::move(value));
+        }
+    }
+
+    // Places every element into new arrays, never touching the storage
+    // being migrated. Growing again in the middle is safe as elements left
+    // in the local arrays are not in the table.
+    void grow(size_t new_capacity)
+    {
+        auto old_used_vec = std::vector<bool>(new_capacity * 2u, false);
+        auto old_data_vec = std::vector<TStorage>(new_capacity * 2u);
+
+        std::swap(used_vec_, old_used_vec);
+        std::swap(data_vec_, old_data_vec);
+
+        drain_stash();
+
+        TStorage buffer;
+        for (size_t index = 0u; index < old_data_vec.size(); ++index)
+        {
+            if (old_used_vec[index])
             {
-                auto& [key, value] = get_data_at(index);
-                new (&new_data_vec[index]) TData{ key, std::move(value) };
-                destruct_at(index);
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                auto& [key, value] = *new (&buffer) TData{ std::move(*ptr) };
+                ptr->~TData();
+                --size_;
+
+                insert_core(key, std::move(value));
+                std::launder(reinterpret_cast<TData*>(&buffer))->~TData();
             }
         }
 
-        used_vec_.resize(new_capacity * 2u, false);
-        data_vec_ = std::move(new_data_vec);
-
-        rehash();
+        drain_overflow();
     }
 
 private:
     size_t size_{};
 
-    size_t left_xor_{ static_cast<size_t>(-1) };
-    size_t right_xor_{};
-
     TLeftHasher left_hasher_{};
     TRightHasher right_hasher_{};
 
     std::vector<bool> used_vec_ = std::vector<bool>(NStartCapacity * 2, false);
     std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity * 2);
+
+    std::vector<bool> stash_used_vec_ = std::vector<bool>(NStashSize, false);
+    std::vector<TStorage> stash_vec_ = std::vector<TStorage>(NStashSize);
+
+    std::list<TData> overflow_list_;
+
+    // Storage being drained by incremental rehash
+    size_t migrate_pos_{};
+    std::vector<bool> old_used_vec_{};
+    std::vector<TStorage> old_data_vec_{};
 };
 
 } // namespace
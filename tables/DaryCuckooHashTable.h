@@ -0,0 +1,635 @@
+#ifndef DARY_CUCKOO_HASHTABLE_H_
+#define DARY_CUCKOO_HASHTABLE_H_
+
+#include "IHashTable.h"
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <list>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+
+namespace {
+
+// Cuckoo hashing with one partition per hasher: every key may live in one
+// slot of each partition. More hashers mean more probes per lookup but
+// a higher load: up to 90% with three hashers and 95% with four.
+template<class TK, class TV, class... THs>
+class CDaryCuckooHashTable final : public IHashTable<TK, TV>
+{
+public:
+    using typename IHashTable<TK, TV>::TKey;
+    using typename IHashTable<TK, TV>::TValue;
+    using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
+    using THashers = std::tuple<THs...>;
+
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    static constexpr size_t NWays = sizeof...(THs);
+    static_assert(NWays >= 2u, "at least two hashers are required");
+
+    static constexpr size_t NStartCapacity = NWays;
+    static constexpr size_t NLoadRatio =
+        (NWays == 2u ? 2u : (NWays == 3u ? 10u : 20u));
+    static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent =
+        (SIsTransparent<THs>::value && ...);
+
+    // Elements that found no eviction path wait here until the table grows
+    static constexpr size_t NStashSize = 4u;
+    // A full stash grows the table only while it is at least
+    // 1/NSpillRatio full, see insert_core()
+    static constexpr size_t NSpillRatio = 4u;
+    // Bound on eviction path search over all candidate chains
+    static constexpr size_t NMaxPathNodes = 512u;
+
+    CDaryCuckooHashTable() = default;
+
+    template<typename TIter>
+    CDaryCuckooHashTable(TIter begin_it, TIter end_it):
+        CDaryCuckooHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CDaryCuckooHashTable(const CDaryCuckooHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        hashers_(other.hashers_),
+        used_vec_(other.used_vec_),
+        data_vec_(other.data_vec_.size()),
+        stash_used_vec_(other.stash_used_vec_),
+        overflow_list_(other.overflow_list_)
+    {
+        for (size_t index = 0u; index < used_vec_.size(); ++index)
+        {
+            if (used_vec_[index])
+                construct_at(index, other.get_data_at(index));
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (stash_used_vec_[index])
+                new (&stash_vec_[index]) TData{ other.get_stash_at(index) };
+        }
+    }
+
+    CDaryCuckooHashTable& operator = (const CDaryCuckooHashTable& other)
+    {
+        if (this != &other)
+        {
+            CDaryCuckooHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CDaryCuckooHashTable(CDaryCuckooHashTable&& other) noexcept:
+        CDaryCuckooHashTable()
+    {
+        swap(other);
+    }
+
+    CDaryCuckooHashTable& operator = (CDaryCuckooHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CDaryCuckooHashTable() final
+    {
+        for (size_t index = 0u; index < used_vec_.size(); ++index)
+        {
+            if (used_vec_[index])
+                destruct_at(index);
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (stash_used_vec_[index])
+                get_stash_at(index).~TData();
+        }
+    }
+
+    void swap(CDaryCuckooHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(hashers_, other.hashers_);
+        std::swap(used_vec_, other.used_vec_);
+        std::swap(data_vec_, other.data_vec_);
+        std::swap(stash_used_vec_, other.stash_used_vec_);
+        std::swap(stash_vec_, other.stash_vec_);
+        std::swap(overflow_list_, other.overflow_list_);
+    }
+
+    [[nodiscard]]
+    virtual size_t size() const noexcept override final
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    virtual size_t capacity() const noexcept override final
+    {
+        return data_vec_.size();
+    }
+
+    [[nodiscard]]
+    virtual bool empty() const noexcept override final
+    {
+        return size_ == 0u;
+    }
+
+    virtual void reserve(size_t count) override final
+    {
+        // Every partition takes an equal power of 2 share
+        size_t part = CPow2Capacity::round(
+                (capacity_for(count, NLoadRatio) + NWays - 1u) / NWays);
+        if (part * NWays > capacity())
+            rehash(part * NWays);
+    }
+
+    virtual bool insert(const TKey& desired,
+                        const TValue& desired_value) override final
+    {
+        return emplace_core<true>(desired, desired_value);
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>>
+        find(const TKey& desired) override final
+    {
+        if (TData* data = search(desired); data != nullptr)
+            return std::ref(data->second);
+
+        return std::nullopt;
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const override final
+    {
+        return find_core(desired);
+    }
+
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    using IHashTable<TK, TV>::capacity_for;
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        if (TData* data = search(desired); data != nullptr)
+        {
+            if constexpr (NAssign)
+                data->second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (capacity() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
+            rehash(capacity() * NRehashFactor);
+
+        insert_core(std::forward<TKeyArg>(desired),
+                    std::forward<Types>(args)...);
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        for (size_t index : positions(desired))
+        {
+            if (!used_vec_[index])
+                continue;
+
+            if (auto& [key, value] = get_data_at(index); key == desired)
+            {
+                destruct_at(index);
+                used_vec_[index] = false;
+                --size_;
+
+                return true;
+            }
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (!stash_used_vec_[index])
+                continue;
+
+            if (auto& [key, value] = get_stash_at(index); key == desired)
+            {
+                get_stash_at(index).~TData();
+                stash_used_vec_[index] = false;
+                --size_;
+
+                return true;
+            }
+        }
+
+        for (auto it = overflow_list_.begin(); it != overflow_list_.end();
+             ++it)
+        {
+            if (it->first == desired)
+            {
+                overflow_list_.erase(it);
+                --size_;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (const TData* data =
+                const_cast<CDaryCuckooHashTable&>(*this).search(desired);
+            data != nullptr)
+            return std::cref(data->second);
+
+        return std::nullopt;
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(size_t idx, Types&&... args)
+    {
+        return new (&data_vec_[idx]) TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(size_t idx)
+    {
+        std::launder(reinterpret_cast<TData*>(&data_vec_[idx]))->~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(size_t idx) const noexcept
+    {
+        return const_cast<CDaryCuckooHashTable*>(this)->get_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&data_vec_[idx]));
+    }
+
+    [[nodiscard]]
+    inline const TData& get_stash_at(size_t idx) const noexcept
+    {
+        return const_cast<CDaryCuckooHashTable*>(this)->get_stash_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_stash_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&stash_vec_[idx]));
+    }
+
+    // Hash of every partition is mixed with its own seed, so partitions
+    // stay independent even if all hashers are the same
+    [[nodiscard]]
+    static inline size_t mix(size_t hash, size_t seed) noexcept
+    {
+        uint64_t result = static_cast<uint64_t>(hash) +
+                          static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15u;
+        result ^= result >> 33u;
+        result *= 0xFF51AFD7ED558CCDu;
+        result ^= result >> 33u;
+        result *= 0xC4CEB9FE1A85EC53u;
+        result ^= result >> 33u;
+
+        return static_cast<size_t>(result);
+    }
+
+    // Partition size is a power of 2, partition `I` starts at I * its size
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::array<size_t, NWays> positions(const TKeyLike& desired) const noexcept
+    {
+        return positions(desired, std::index_sequence_for<THs...>{});
+    }
+
+    template<typename TKeyLike, size_t... NIs>
+    [[nodiscard]]
+    std::array<size_t, NWays> positions(
+            const TKeyLike& desired,
+            std::index_sequence<NIs...>) const noexcept
+    {
+        size_t part = capacity() / NWays;
+        return { (
+                (mix(std::get<NIs>(hashers_)(desired), NIs) & (part - 1u)) +
+                NIs * part
+            )... };
+    }
+
+    // Returns the element with `desired` key or nullptr if none
+    template<typename TKeyLike>
+    [[nodiscard]]
+    TData* search(const TKeyLike& desired) noexcept
+    {
+        for (size_t index : positions(desired))
+        {
+            if (used_vec_[index])
+            {
+                if (auto& data = get_data_at(index); data.first == desired)
+                    return &data;
+            }
+        }
+
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (stash_used_vec_[index])
+            {
+                if (auto& data = get_stash_at(index); data.first == desired)
+                    return &data;
+            }
+        }
+
+        for (auto& data : overflow_list_)
+        {
+            if (data.first == desired)
+                return &data;
+        }
+
+        return nullptr;
+    }
+
+    // Puts a key known to be absent, evicting others along the way. Only
+    // growth costs more than a bounded amount of work. Keys that still do
+    // not fit a table sparser than 1/NSpillRatio share their slots, so they
+    // go to the overflow list instead of growing the table without bound.
+    // Does not count the key in size_.
+    template<typename TKeyArg, typename... Types>
+    void insert_core(TKeyArg&& desired, Types&&... args)
+    {
+        for (;;)
+        {
+            if (size_t target = make_room(desired); target != capacity())
+            {
+                construct_at(target, std::piecewise_construct,
+                             std::forward_as_tuple(
+                                 std::forward<TKeyArg>(desired)),
+                             std::forward_as_tuple(
+                                 std::forward<Types>(args)...));
+                used_vec_[target] = true;
+
+                return;
+            }
+
+            for (size_t index = 0u; index < NStashSize; ++index)
+            {
+                if (!stash_used_vec_[index])
+                {
+                    new (&stash_vec_[index]) TData{
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                        std::forward_as_tuple(std::forward<Types>(args)...) };
+                    stash_used_vec_[index] = true;
+
+                    return;
+                }
+            }
+
+            if (capacity() > size_ * NSpillRatio)
+            {
+                overflow_list_.emplace_back(
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                        std::forward_as_tuple(std::forward<Types>(args)...));
+
+                return;
+            }
+
+            rehash(capacity() * NRehashFactor);
+        }
+    }
+
+    // Frees one of the slots of `desired` by moving keys along the shortest
+    // eviction path found with breadth-first search. Returns the freed slot
+    // or capacity() if there is no short enough path.
+    template<typename TKeyLike>
+    [[nodiscard]]
+    size_t make_room(const TKeyLike& desired)
+    {
+        struct SPathNode
+        {
+            size_t index;
+            size_t parent;
+        };
+
+        SPathNode path[NMaxPathNodes];
+        size_t tail = 0u;
+        for (size_t index : positions(desired))
+        {
+            if (!used_vec_[index])
+                return index;
+
+            path[tail++] = SPathNode{ index, NMaxPathNodes };
+        }
+
+        size_t part = capacity() / NWays;
+        for (size_t head = 0u; head < tail; ++head)
+        {
+            size_t index = path[head].index;
+            for (size_t next_index : positions(get_data_at(index).first))
+            {
+                // Own partition of the key is the slot it already takes
+                if (next_index / part == index / part)
+                    continue;
+
+                if (used_vec_[next_index])
+                {
+                    if (tail < NMaxPathNodes)
+                        path[tail++] = SPathNode{ next_index, head };
+
+                    continue;
+                }
+
+                // Every key on the path moves one step towards the free slot
+                used_vec_[next_index] = true;
+                for (size_t node = head; node != NMaxPathNodes;
+                     node = path[node].parent)
+                {
+                    construct_at(next_index,
+                                 std::move(get_data_at(path[node].index)));
+                    destruct_at(path[node].index);
+                    next_index = path[node].index;
+                }
+
+                used_vec_[next_index] = false;
+
+                return next_index;
+            }
+        }
+
+        return capacity();
+    }
+
+    // Growing again in the middle is safe as elements left in the local
+    // arrays are not in the table
+    void rehash(size_t new_capacity)
+    {
+        if (new_capacity % NWays != 0u || new_capacity < size_)
+            throw std::invalid_argument(
+                    "CDaryCuckooHashTable::rehash(): "
+                    "invalid new_capacity"
+                    );
+
+        auto old_used_vec = std::vector<bool>(new_capacity, false);
+        auto old_data_vec = std::vector<TStorage>(new_capacity);
+
+        std::list<TData> old_overflow_list;
+
+        std::swap(used_vec_, old_used_vec);
+        std::swap(data_vec_, old_data_vec);
+        std::swap(overflow_list_, old_overflow_list);
+
+        TStorage buffer;
+        for (size_t index = 0u; index < NStashSize; ++index)
+        {
+            if (!stash_used_vec_[index])
+                continue;
+
+            // Stash slot is released first, so it is never full here
+            auto& [key, value] = *new (&buffer) TData{
+                std::move(get_stash_at(index)) };
+            get_stash_at(index).~TData();
+            stash_used_vec_[index] = false;
+
+            insert_core(key, std::move(value));
+            std::launder(reinterpret_cast<TData*>(&buffer))->~TData();
+        }
+
+        for (size_t index = 0u; index < old_data_vec.size(); ++index)
+        {
+            if (old_used_vec[index])
+            {
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                auto& [key, value] = *new (&buffer) TData{ std::move(*ptr) };
+                ptr->~TData();
+
+                insert_core(key, std::move(value));
+                std::launder(reinterpret_cast<TData*>(&buffer))->~TData();
+            }
+        }
+
+        for (; !old_overflow_list.empty(); old_overflow_list.pop_front())
+        {
+            auto& [key, value] = old_overflow_list.front();
+            insert_core(key, std::move(value));
+        }
+    }
+
+private:
+    size_t size_{};
+    THashers hashers_{};
+
+    std::vector<bool> used_vec_ = std::vector<bool>(NStartCapacity, false);
+    std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+
+    std::vector<bool> stash_used_vec_ = std::vector<bool>(NStashSize, false);
+    std::vector<TStorage> stash_vec_ = std::vector<TStorage>(NStashSize);
+
+    std::list<TData> overflow_list_;
+};
+
+} // namespace
+
+#endif // DARY_CUCKOO_HASHTABLE_H_
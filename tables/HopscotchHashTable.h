@@ -0,0 +1,578 @@
+#ifndef HOPSCOTCH_HASHTABLE_H_
+#define HOPSCOTCH_HASHTABLE_H_
+
+#include "IHashTable.h"
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
+
+namespace {
+
+// Every key is kept within NH slots of its home bucket. The home bucket has
+// a bitmap of the neighborhood slots holding its keys, so a lookup, hit or
+// miss, checks at most NH consecutive slots. Insert moves a free slot closer
+// to the home bucket by swapping it with keys that stay in their own
+// neighborhoods.
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 10u,
+         class TC = CPow2Capacity, size_t NH = 32u>
+class CHopscotchHashTable final : public IHashTable<TK, TV>
+{
+public:
+    static_assert(NH > 1u && NH <= 64u, "neighborhood must fit a bitmap");
+
+    using typename IHashTable<TK, TV>::TKey;
+    using typename IHashTable<TK, TV>::TValue;
+    using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
+    using THasher = TH;
+    using TCapacity = TC;
+
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    using TBitmap = std::conditional_t<NH <= 32u, uint32_t, uint64_t>;
+
+    static constexpr size_t NNeighborhood = NH;
+    static constexpr size_t NLoadRatio = NLR;
+    static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+
+    // Neighborhoods must not wrap onto themselves
+    static constexpr size_t NStartCapacity = TCapacity::round(NNeighborhood);
+
+    // How far a free slot is looked for before the table grows
+    static constexpr size_t NMaxProbe = NNeighborhood * 16u;
+
+    // A key without a free slot near its home bucket grows the table only
+    // while it is at least 1/NSpillRatio full. Keys that do not fit a sparser
+    // table share their home buckets, so they go to the overflow list
+    // instead of growing the table without bound.
+    static constexpr size_t NSpillRatio = 4u;
+
+    CHopscotchHashTable() = default;
+
+    template<typename TIter>
+    CHopscotchHashTable(TIter begin_it, TIter end_it):
+        CHopscotchHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CHopscotchHashTable(const CHopscotchHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        hasher_(other.hasher_),
+        bucket_vec_(other.bucket_vec_.size()),
+        data_vec_(other.data_vec_.size()),
+        overflow_list_(other.overflow_list_)
+    {
+        for (size_t index = 0u; index < bucket_vec_.size(); ++index)
+        {
+            if (other.bucket_vec_[index].used)
+                construct_at(index, other.get_data_at(index));
+
+            bucket_vec_[index] = other.bucket_vec_[index];
+        }
+    }
+
+    CHopscotchHashTable& operator = (const CHopscotchHashTable& other)
+    {
+        if (this != &other)
+        {
+            CHopscotchHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CHopscotchHashTable(CHopscotchHashTable&& other) noexcept:
+        CHopscotchHashTable()
+    {
+        swap(other);
+    }
+
+    CHopscotchHashTable& operator = (CHopscotchHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CHopscotchHashTable() final
+    {
+        for (size_t index = 0u; index < bucket_vec_.size(); ++index)
+        {
+            if (bucket_vec_[index].used)
+                destruct_at(index);
+        }
+    }
+
+    void swap(CHopscotchHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(hasher_, other.hasher_);
+        std::swap(bucket_vec_, other.bucket_vec_);
+        std::swap(data_vec_, other.data_vec_);
+        std::swap(overflow_list_, other.overflow_list_);
+    }
+
+    [[nodiscard]]
+    virtual size_t size() const noexcept override final
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    virtual size_t capacity() const noexcept override final
+    {
+        return data_vec_.size();
+    }
+
+    [[nodiscard]]
+    virtual bool empty() const noexcept override final
+    {
+        return size_ == 0u;
+    }
+
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, NLoadRatio));
+        if (new_capacity > capacity())
+            rehash(new_capacity);
+    }
+
+    virtual bool insert(const TKey& desired,
+                        const TValue& desired_value) override final
+    {
+        return emplace_core<true>(desired, desired_value);
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>>
+        find(const TKey& desired) override final
+    {
+        auto result =
+            const_cast<const CHopscotchHashTable&>(*this).find(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const override final
+    {
+        return find_core(desired);
+    }
+
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    using IHashTable<TK, TV>::capacity_for;
+
+    // `hop` describes the neighborhood of the bucket as a home, `used` the
+    // slot itself
+    struct SBucket
+    {
+        TBitmap hop;
+        bool used;
+    };
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        size_t home = home_of(desired);
+        if (size_t found = search(desired, home); found != capacity())
+        {
+            if constexpr (NAssign)
+                get_data_at(found).second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+        {
+            if constexpr (NAssign)
+                found->second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        if (capacity() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
+        {
+            rehash(capacity() * NRehashFactor);
+            home = home_of(desired);
+        }
+
+        size_t free = make_room(home);
+        while (free == capacity())
+        {
+            if (capacity() > size_ * NSpillRatio)
+            {
+                overflow_list_.emplace_back(
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                        std::forward_as_tuple(std::forward<Types>(args)...));
+                ++size_;
+
+                return true;
+            }
+
+            rehash(capacity() * NRehashFactor);
+            home = home_of(desired);
+            free = make_room(home);
+        }
+
+        place(home, free, std::piecewise_construct,
+              std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+              std::forward_as_tuple(std::forward<Types>(args)...));
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        size_t home = home_of(desired);
+        size_t found = search(desired, home);
+        if (found == capacity())
+        {
+            auto overflow = search_overflow(desired);
+            if (overflow == overflow_list_.end())
+                return false;
+
+            overflow_list_.erase(overflow);
+            --size_;
+
+            return true;
+        }
+
+        destruct_at(found);
+        bucket_vec_[found].used = false;
+        bucket_vec_[home].hop ^= TBitmap{ 1u } << distance(home, found);
+        --size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (size_t found = search(desired, home_of(desired));
+            found != capacity())
+        {
+            auto& [key, value] = get_data_at(found);
+            return std::make_optional(std::cref(value));
+        }
+
+        if (auto found = search_overflow(desired);
+            found != overflow_list_.end())
+            return std::make_optional(std::cref(found->second));
+
+        return std::nullopt;
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(size_t idx, Types&&... args)
+    {
+        return new (&data_vec_[idx]) TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(size_t idx)
+    {
+        std::launder(reinterpret_cast<TData*>(&data_vec_[idx]))->~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(size_t idx) const noexcept
+    {
+        return const_cast<CHopscotchHashTable*>(this)->get_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&data_vec_[idx]));
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline size_t home_of(const TKeyLike& desired) const noexcept
+    {
+        return TCapacity::index(hasher_(desired), capacity());
+    }
+
+    [[nodiscard]]
+    inline size_t distance(size_t from, size_t to) const noexcept
+    {
+        return TCapacity::index(to + capacity() - from, capacity());
+    }
+
+    [[nodiscard]]
+    static inline size_t lowest_bit(TBitmap hop) noexcept
+    {
+        return static_cast<size_t>(__builtin_ctzll(hop));
+    }
+
+    // Returns the slot holding `desired` or capacity() if none
+    template<typename TKeyLike>
+    [[nodiscard]]
+    size_t search(const TKeyLike& desired, size_t home) const noexcept
+    {
+        for (TBitmap hop = bucket_vec_[home].hop; hop != 0u; hop &= hop - 1u)
+        {
+            size_t index = TCapacity::index(home + lowest_bit(hop),
+                                            capacity());
+            if (get_data_at(index).first == desired)
+                return index;
+        }
+
+        return capacity();
+    }
+
+    // Is empty unless the hasher maps many keys to the same home buckets
+    template<typename TKeyLike>
+    [[nodiscard]]
+    typename std::list<TData>::iterator
+        search_overflow(const TKeyLike& desired)
+    {
+        return std::find_if(overflow_list_.begin(), overflow_list_.end(),
+                            [&desired](const TData& data)
+                            { return data.first == desired; });
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    typename std::list<TData>::const_iterator
+        search_overflow(const TKeyLike& desired) const
+    {
+        return const_cast<CHopscotchHashTable*>(this)->
+            search_overflow(desired);
+    }
+
+    // Finds a free slot within the neighborhood of `home`, hopping the
+    // nearest free slot backwards if needed. Returns capacity() if there is
+    // none, keys moved on the way stay in their neighborhoods.
+    [[nodiscard]]
+    size_t make_room(size_t home)
+    {
+        size_t dist = 0u;
+        size_t max_dist = std::min(NMaxProbe, capacity());
+        while (dist < max_dist &&
+               bucket_vec_[TCapacity::index(home + dist, capacity())].used)
+            ++dist;
+
+        if (dist == max_dist)
+            return capacity();
+
+        while (dist >= NNeighborhood)
+        {
+            size_t free = TCapacity::index(home + dist, capacity());
+            size_t back = NNeighborhood - 1u;
+
+            // The farthest bucket goes first as it moves the slot the most
+            for (; back > 0u; --back)
+            {
+                size_t bucket =
+                    TCapacity::index(free + capacity() - back, capacity());
+
+                TBitmap hop = bucket_vec_[bucket].hop &
+                              ((TBitmap{ 1u } << back) - 1u);
+                if (hop == 0u)
+                    continue;
+
+                size_t offset = lowest_bit(hop);
+                size_t from = TCapacity::index(bucket + offset, capacity());
+
+                construct_at(free, std::move(get_data_at(from)));
+                bucket_vec_[free].used = true;
+                destruct_at(from);
+                bucket_vec_[from].used = false;
+
+                bucket_vec_[bucket].hop ^= (TBitmap{ 1u } << offset) |
+                                           (TBitmap{ 1u } << back);
+                dist -= back - offset;
+                break;
+            }
+
+            if (back == 0u)
+                return capacity();
+        }
+
+        return TCapacity::index(home + dist, capacity());
+    }
+
+    template<typename... Types>
+    inline void place(size_t home, size_t free, Types&&... args)
+    {
+        construct_at(free, std::forward<Types>(args)...);
+        bucket_vec_[free].used = true;
+        bucket_vec_[home].hop |= TBitmap{ 1u } << distance(home, free);
+    }
+
+    // Moves `data` into the table or, see NSpillRatio, the overflow list
+    void settle(TData& data)
+    {
+        size_t home = home_of(data.first);
+        size_t free = make_room(home);
+        while (free == capacity())
+        {
+            if (capacity() > size_ * NSpillRatio)
+            {
+                overflow_list_.push_back(std::move(data));
+                return;
+            }
+
+            rehash(capacity() * NRehashFactor);
+            home = home_of(data.first);
+            free = make_room(home);
+        }
+
+        place(home, free, std::move(data));
+    }
+
+    void rehash(size_t new_capacity)
+    {
+        if (new_capacity <= capacity())
+            throw std::invalid_argument(
+                    "CHopscotchHashTable::rehash(): "
+                    "new_capacity <= capacity()"
+                    );
+
+        auto old_bucket_vec =
+            std::vector<SBucket>(new_capacity, SBucket{ 0u, false });
+        auto old_data_vec = std::vector<TStorage>(new_capacity);
+
+        std::list<TData> old_overflow_list;
+
+        std::swap(bucket_vec_, old_bucket_vec);
+        std::swap(data_vec_, old_data_vec);
+        std::swap(overflow_list_, old_overflow_list);
+
+        // Elements left in the old arrays are not in the new ones, so
+        // growing again in the middle is safe
+
+        for (size_t index = 0u; index < old_data_vec.size(); ++index)
+        {
+            if (old_bucket_vec[index].used)
+            {
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                settle(*ptr);
+                ptr->~TData();
+            }
+        }
+
+        for (; !old_overflow_list.empty(); old_overflow_list.pop_front())
+            settle(old_overflow_list.front());
+    }
+
+private:
+    size_t size_{};
+    THasher hasher_{};
+
+    std::vector<SBucket> bucket_vec_ =
+        std::vector<SBucket>(NStartCapacity, SBucket{ 0u, false });
+    std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+
+    std::list<TData> overflow_list_;
+};
+
+} // namespace
+
+#endif // HOPSCOTCH_HASHTABLE_H_
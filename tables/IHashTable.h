@@ -5,9 +5,40 @@
 #include <utility>
 #include <optional>
 #include <functional>
+#include <iterator>
+#include <type_traits>
 
 namespace {
 
+// Hashers declaring `is_transparent` hash any type comparable with the key
+// the same way as the key itself, so lookups need not construct a key
+template<typename THasher, typename = void>
+struct SIsTransparent : std::false_type {};
+
+template<typename THasher>
+struct SIsTransparent<THasher, std::void_t<typename THasher::is_transparent>> :
+    std::true_type {};
+
+// Enables heterogeneous overloads for types the key can not be implicitly
+// built from, others are converted and take the key overloads
+template<typename TKeyLike, typename TRawKey, bool NIsTransparent>
+using TEnableIfKeyLike = std::enable_if_t<
+    NIsTransparent && !std::is_convertible_v<const TKeyLike&, TRawKey>>;
+
+// Length of [begin_it, end_it) if it can be measured without consuming the
+// range, that is for forward iterators, otherwise zero
+template<typename TIter>
+[[nodiscard]]
+size_t range_size(TIter begin_it, TIter end_it)
+{
+    using TCategory = typename std::iterator_traits<TIter>::iterator_category;
+
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, TCategory>)
+        return static_cast<size_t>(std::distance(begin_it, end_it));
+    else
+        return 0u;
+}
+
 template<class TK, class TV>
 class IHashTable
 {
@@ -16,6 +47,9 @@ public:
     using TValue = TV;
     using TData = std::pair<TKey, TValue>;
 
+    // Key that can be moved from
+    using TRawKey = std::remove_cv_t<std::remove_reference_t<TK>>;
+
     IHashTable() = default;
 
     IHashTable             (const IHashTable&) = default;
@@ -29,9 +63,20 @@ public:
     [[nodiscard]] virtual size_t capacity() const noexcept = 0;
     [[nodiscard]] virtual bool empty() const noexcept = 0;
 
+    // Grows the table once, so that up to `count` elements fit without
+    // a rehash; never shrinks it
+    virtual void reserve(size_t count) = 0;
+
+    // Shrinks the table to the least capacity that fits its elements and
+    // gives the rest of storage back; tables that can not shrink ignore it
+    virtual void shrink_to_fit();
+
     virtual bool insert(const TKey&, const TValue&) = 0;
     virtual bool erase(const TKey&) = 0;
 
+    // Tables override it to move both into place, this one copies them
+    virtual bool insert(TRawKey&& key, TValue&& value);
+
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<TValue>> 
         find(const TKey&) = 0;
@@ -39,6 +84,40 @@ public:
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<const TValue>> 
         find(const TKey&) const = 0;
+
+    // Batched operations behave as the single ones applied in order and
+    // return how many keys were inserted, erased or found. Tables override
+    // them to prefetch a group of slots before touching any of them.
+    virtual size_t insert_batch(const TKey* keys, const TValue* values,
+                                size_t count);
+    virtual size_t erase_batch(const TKey* keys, size_t count);
+
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<TValue>>* results);
+
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<const TValue>>* results
+            ) const;
+
+protected:
+    // Keys resolved together by batched operations
+    static constexpr size_t NBatchGroup = 16u;
+
+    static inline void prefetch(const void* address) noexcept
+    {
+        __builtin_prefetch(address);
+    }
+
+    // Least capacity that passes the load check of the tables,
+    // capacity * (ratio - 1) >= count * ratio
+    [[nodiscard]]
+    static constexpr size_t capacity_for(size_t count,
+                                         size_t ratio) noexcept
+    {
+        return (count * ratio + ratio - 2u) / (ratio - 1u);
+    }
 };
 
 template<class TK, class TV>
@@ -47,6 +126,68 @@ bool IHashTable<TK, TV>::empty() const noexcept
     return size() == 0u;
 }
 
+template<class TK, class TV>
+void IHashTable<TK, TV>::shrink_to_fit()
+{}
+
+template<class TK, class TV>
+bool IHashTable<TK, TV>::insert(TRawKey&& key, TValue&& value)
+{
+    return insert(static_cast<const TKey&>(key),
+                  static_cast<const TValue&>(value));
+}
+
+template<class TK, class TV>
+size_t IHashTable<TK, TV>::insert_batch(const TKey* keys,
+                                        const TValue* values, size_t count)
+{
+    size_t result = 0u;
+    for (size_t index = 0u; index < count; ++index)
+        result += insert(keys[index], values[index]);
+
+    return result;
+}
+
+template<class TK, class TV>
+size_t IHashTable<TK, TV>::erase_batch(const TKey* keys, size_t count)
+{
+    size_t result = 0u;
+    for (size_t index = 0u; index < count; ++index)
+        result += erase(keys[index]);
+
+    return result;
+}
+
+template<class TK, class TV>
+size_t IHashTable<TK, TV>::find_batch(
+        const TKey* keys, size_t count,
+        std::optional<std::reference_wrapper<TValue>>* results)
+{
+    size_t result = 0u;
+    for (size_t index = 0u; index < count; ++index)
+    {
+        results[index] = find(keys[index]);
+        result += results[index].has_value();
+    }
+
+    return result;
+}
+
+template<class TK, class TV>
+size_t IHashTable<TK, TV>::find_batch(
+        const TKey* keys, size_t count,
+        std::optional<std::reference_wrapper<const TValue>>* results) const
+{
+    size_t result = 0u;
+    for (size_t index = 0u; index < count; ++index)
+    {
+        results[index] = find(keys[index]);
+        result += results[index].has_value();
+    }
+
+    return result;
+}
+
 } // namespace
 
 #endif // IHASHTABLE_H_
@@ -2,33 +2,112 @@
 #define OPEN_ADDR_HASHTABLE_H_
 
 #include "IHashTable.h"
+#include "ProbePolicy.h"
+#include "CapacityPolicy.h"
+#include "RehashPolicy.h"
+#include "ShrinkPolicy.h"
 
 #include <iostream>
 
 #include <new>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <utility>
 #include <optional>
 #include <functional>
 #include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
 
 namespace {
 
-template<class TK, class TV>
+// Probing strategy, capacity reduction and rehash mode are compile-time
+// policies, so the whole probe loop is inlined; virtual functions only wrap
+// it for IHashTable
+template<class TK, class TV, class TP, size_t NLR,
+         class TC = CPow2Capacity, class TR = CFullRehash,
+         class TS = CNoShrink>
 class IOpenAddrHashTable : public IHashTable<TK, TV>
 {
 public:
     using typename IHashTable<TK, TV>::TKey;
     using typename IHashTable<TK, TV>::TValue;
     using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
 
-    using TStorage = 
+    using TProbe = TP;
+    using TCapacity = TC;
+    using TRehash = TR;
+    using TShrink = TS;
+
+    using TStorage =
         typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
 
+    // Per-slot metadata: state in the low bits, hash fingerprint in the rest
+    using TMeta = uint32_t;
+
     static constexpr size_t NStartCapacity = 1u;
+    static constexpr size_t NLoadRatio = NLR;
+    static constexpr bool NIsTransparent = TProbe::NIsTransparent;
     static constexpr double NRehashFactor = 2.0;
 
+    static constexpr size_t NMetaStateBits = 2u;
+    static constexpr TMeta NMetaEmpty = 0u;
+    static constexpr TMeta NMetaSkip = 1u;
+    static constexpr TMeta NMetaUsed = 2u;
+    // Used slot not yet put in place by cleanup()
+    static constexpr TMeta NMetaPending = NMetaUsed | NMetaSkip;
+    static constexpr TMeta NMetaStateMask = NMetaPending;
+
+    // Table regions per thread of build(), so threads that finish early
+    // take over more of them
+    static constexpr size_t NBuildSplit = 16u;
+
+    // Every capacity reserve() and shrinking pick comes from TCapacity
+    static_assert(!TProbe::NNeedsPowerOfTwo || TCapacity::NIsPowerOfTwo,
+                  "probe sequence visits every slot of 2^n capacity only");
+
     IOpenAddrHashTable() = default;
 
+    IOpenAddrHashTable(const IOpenAddrHashTable& other):
+        IHashTable<TK, TV>(other),
+        probe_(other.probe_)
+    {
+        assign(other);
+    }
+
+    IOpenAddrHashTable& operator = (const IOpenAddrHashTable& other)
+    {
+        if (this != &other)
+        {
+            destroy();
+            probe_ = other.probe_;
+            assign(other);
+        }
+
+        return *this;
+    }
+
+    IOpenAddrHashTable(IOpenAddrHashTable&& other) noexcept:
+        IOpenAddrHashTable()
+    {
+        swap(other);
+    }
+
+    IOpenAddrHashTable& operator = (IOpenAddrHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~IOpenAddrHashTable()
+    {
+        destroy();
+    }
+
     [[nodiscard]]
     virtual size_t size() const noexcept override final
     {
@@ -47,19 +126,197 @@ public:
         return size_ == 0u;
     }
 
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = fit_capacity(count);
+        if (new_capacity > capacity())
+        {
+            rehash(new_capacity);
+            complete_rehash();
+        }
+    }
+
+    // Drops tombstones even if the capacity stays
+    virtual void shrink_to_fit() override final
+    {
+        complete_rehash();
+
+        if (shrink_to(size_))
+            complete_rehash();
+        else if (skip_count_ != 0u)
+            cleanup();
+    }
+
     virtual bool insert(const TKey& key, const TValue& value) override = 0;
 
     virtual bool erase(const TKey& desired) override = 0;
 
     [[nodiscard]]
-    virtual std::optional<std::reference_wrapper<TValue>> 
+    virtual std::optional<std::reference_wrapper<TValue>>
         find(const TKey& key) override = 0;
 
     [[nodiscard]]
-    virtual std::optional<std::reference_wrapper<const TValue>> 
+    virtual std::optional<std::reference_wrapper<const TValue>>
         find(const TKey& desired) const override = 0;
 
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        SProbe probe = pos(desired);
+        return emplace_hashed<true>(probe, std::move(desired),
+                                    std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_hashed<false>(pos(desired), desired,
+                                     std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        SProbe probe = pos(desired);
+        return emplace_hashed<false>(probe, std::move(desired),
+                                     std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_hashed(pos(desired), desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        migrate_step();
+
+        auto result = find_hashed(pos(desired), desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_hashed(pos(desired), desired);
+    }
+
+    virtual size_t insert_batch(const TKey* keys, const TValue* values,
+                                size_t count) override final;
+
+    virtual size_t erase_batch(const TKey* keys,
+                               size_t count) override final;
+
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<TValue>>* results
+            ) override final;
+
+    virtual size_t find_batch(
+            const TKey* keys, size_t count,
+            std::optional<std::reference_wrapper<const TValue>>* results
+            ) const override final;
+
 protected:
+    // Layout of mapped files reads the storage directly
+    template<class> friend class COpenAddrLayout;
+
+    using IHashTable<TK, TV>::NBatchGroup;
+    using IHashTable<TK, TV>::capacity_for;
+    using IHashTable<TK, TV>::prefetch;
+
+    // Hashes of the key that determine its whole probe sequence
+    using SProbe = typename TProbe::SProbe;
+
+    void swap(IOpenAddrHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(skip_count_, other.skip_count_);
+        std::swap(probe_, other.probe_);
+        std::swap(meta_vec_, other.meta_vec_);
+        std::swap(data_vec_, other.data_vec_);
+        std::swap(migrate_pos_, other.migrate_pos_);
+        std::swap(old_meta_vec_, other.old_meta_vec_);
+        std::swap(old_data_vec_, other.old_data_vec_);
+    }
+
+    void assign(const IOpenAddrHashTable& other)
+    {
+        // Metadata is copied slot by slot to stay consistent if a copy throws
+        meta_vec_ = std::vector<TMeta>(other.meta_vec_.size(), NMetaEmpty);
+        data_vec_ = std::vector<TStorage>(other.data_vec_.size());
+        for (size_t index = 0u; index < meta_vec_.size(); ++index)
+        {
+            if (is_used(other.meta_vec_[index]))
+                construct_at(index, other.get_data_at(index));
+
+            meta_vec_[index] = other.meta_vec_[index];
+        }
+
+        old_meta_vec_ =
+            std::vector<TMeta>(other.old_meta_vec_.size(), NMetaEmpty);
+        old_data_vec_ = std::vector<TStorage>(other.old_data_vec_.size());
+        for (size_t index = 0u; index < old_meta_vec_.size(); ++index)
+        {
+            if (is_used(other.old_meta_vec_[index]))
+                new (&old_data_vec_[index]) TData{
+                    other.get_old_data_at(index) };
+
+            old_meta_vec_[index] = other.old_meta_vec_[index];
+        }
+
+        size_ = other.size_;
+        skip_count_ = other.skip_count_;
+        migrate_pos_ = other.migrate_pos_;
+    }
+
+    void destroy() noexcept
+    {
+        for (size_t index = 0u; index < meta_vec_.size(); ++index)
+        {
+            if (is_used(meta_vec_[index]))
+                destruct_at(index);
+        }
+
+        for (size_t index = 0u; index < old_meta_vec_.size(); ++index)
+        {
+            if (is_used(old_meta_vec_[index]))
+                get_old_data_at(index).~TData();
+        }
+
+        meta_vec_.assign(meta_vec_.size(), NMetaEmpty);
+        old_meta_vec_ = std::vector<TMeta>();
+        old_data_vec_ = std::vector<TStorage>();
+        size_ = 0u;
+        skip_count_ = 0u;
+        migrate_pos_ = 0u;
+    }
+
     template<typename... Types>
     inline TData* construct_at(size_t idx, Types&&... args)
     {
@@ -84,79 +341,301 @@ protected:
     }
 
     [[nodiscard]]
-    virtual size_t run(size_t index, size_t count) const noexcept = 0;
+    inline const TData& get_old_data_at(size_t idx) const noexcept
+    {
+        return const_cast<IOpenAddrHashTable*>(this)->get_old_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_old_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&old_data_vec_[idx]));
+    }
+
+    [[nodiscard]]
+    static inline TMeta make_meta(size_t hash) noexcept
+    {
+        auto fingerprint = static_cast<TMeta>(hash ^ (hash >> 32u));
+        return NMetaUsed | (fingerprint << NMetaStateBits);
+    }
+
+    [[nodiscard]]
+    static inline bool is_used(TMeta meta) noexcept
+    {
+        return (meta & NMetaUsed) != 0u;
+    }
+
+    [[nodiscard]]
+    static inline size_t run(const SProbe& probe, size_t count,
+                             size_t capacity) noexcept
+    {
+        return TCapacity::index(TProbe::run(probe, count), capacity);
+    }
+
+    [[nodiscard]]
+    inline size_t run(const SProbe& probe, size_t count) const noexcept
+    {
+        return run(probe, count, data_vec_.size());
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline SProbe pos(const TKeyLike& desired) const noexcept
+    {
+        return probe_.pos(desired);
+    }
+
+    // Old storage is kept only while incremental rehash is in progress
+    [[nodiscard]]
+    inline bool is_migrating() const noexcept
+    {
+        return TRehash::NMigrateStep != 0u && !old_meta_vec_.empty();
+    }
+
+    inline void migrate_step()
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep);
+    }
+
+    // Steps of `count` operations at once, so that elements found by
+    // a batch are not moved by its own later steps
+    inline void migrate_steps(size_t count)
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(TRehash::NMigrateStep * count);
+    }
+
+    inline void complete_rehash()
+    {
+        if constexpr (TRehash::NMigrateStep != 0u)
+            migrate(old_data_vec_.size());
+    }
+
+    // Single key operations once the key is hashed. A present key gets
+    // the value assigned if NAssign, otherwise the table is left as is.
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_hashed(const SProbe& probe, TKeyArg&& desired,
+                        Types&&... args);
+
+    template<typename TKeyLike>
+    bool erase_hashed(const SProbe& probe, const TKeyLike& desired);
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_hashed(const SProbe& probe, const TKeyLike& desired) const;
 
+    // Hashes a group of keys and prefetches the first slot of each one
+    void prefetch_group(const TKey* keys, size_t count,
+                        SProbe* probes) const noexcept;
+
+    // Returns index of the slot holding `desired` or capacity if none
+    template<typename TKeyLike>
     [[nodiscard]]
-    virtual size_t pos(const TKey& desired) const noexcept = 0;
+    size_t search(const SProbe& probe, TMeta desired_meta,
+                  const TKeyLike& desired) const noexcept;
 
+    template<typename TKeyLike>
     [[nodiscard]]
-    virtual size_t get_load_ratio() const noexcept = 0;
+    size_t search_old(const SProbe& probe, TMeta desired_meta,
+                      const TKeyLike& desired) const noexcept;
+
+    // Puts a key known to be absent into the first free slot
+    template<typename... Types>
+    void place(const SProbe& probe, Types&&... args);
+
+    void migrate(size_t count);
+
+    void rehash(size_t new_capacity);
+
+    // Least capacity of the policy that fits `count` elements
+    [[nodiscard]]
+    static inline size_t fit_capacity(size_t count) noexcept
+    {
+        return TCapacity::round(capacity_for(count, NLoadRatio));
+    }
+
+    // Rehashes into the least capacity that fits `count` elements if it is
+    // below the current one, returns whether it did
+    bool shrink_to(size_t count)
+    {
+        size_t new_capacity = fit_capacity(count);
+        if (new_capacity >= data_vec_.size())
+            return false;
+
+        rehash(new_capacity);
+        return true;
+    }
+
+    inline void shrink_on_erase()
+    {
+        if constexpr (TShrink::NShrinkRatio != 0u)
+        {
+            if (size_ * TShrink::NShrinkRatio < data_vec_.size())
+                shrink_to(2u * size_);
+        }
+    }
 
-    virtual void rehash(size_t new_capacity) = 0;
+    // Inserts [begin_it, begin_it + count) into the empty table on
+    // `thread_count` threads
+    template<typename TIter>
+    void build(TIter begin_it, size_t count, size_t thread_count);
+
+    // Runs func(0), ..., func(thread_count - 1) on as many threads
+    template<typename TFunc>
+    static void run_threads(size_t thread_count, const TFunc& func);
+
+    void cleanup();
 
 private:
     size_t size_{};
+    size_t skip_count_{};
+    TProbe probe_{};
 
-    std::vector<bool> skip_vec_ = std::vector<bool>(NStartCapacity, false);
-    std::vector<bool> used_vec_ = std::vector<bool>(NStartCapacity, false);
-
+    std::vector<TMeta> meta_vec_ =
+        std::vector<TMeta>(NStartCapacity, NMetaEmpty);
     std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+
+    // Storage being drained by incremental rehash, migrated slots are skipped
+    size_t migrate_pos_{};
+    std::vector<TMeta> old_meta_vec_{};
+    std::vector<TStorage> old_data_vec_{};
 };
 
-template<class TK, class TV>
-bool IOpenAddrHashTable<TK, TV>::
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+bool IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
 insert(const TKey& desired, const TValue& desired_value)
 {
-    size_t ratio = get_load_ratio();
-    if (data_vec_.size() * (ratio - 1) < (size_ + 1) * ratio)
-        rehash(data_vec_.size() * NRehashFactor);
+    return emplace_hashed<true>(pos(desired), desired, desired_value);
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<bool NAssign, typename TKeyArg, typename... Types>
+bool IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+emplace_hashed(const SProbe& probe, TKeyArg&& desired, Types&&... args)
+{
+    static_assert(!NAssign || sizeof...(Types) == 1u,
+                  "assignment takes the value alone");
+
+    migrate_step();
+
+    // Tombstones are counted too as they lengthen probe sequences
+    if (data_vec_.size() * (NLoadRatio - 1) <
+        (size_ + skip_count_ + 1) * NLoadRatio)
+    {
+        complete_rehash();
+
+        // Dropping the tombstones is enough if live keys take at most half
+        // of the allowed load, otherwise the table grows
+        if (data_vec_.size() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio * 2u)
+            rehash(data_vec_.size() * NRehashFactor);
+        else
+            cleanup();
+    }
+
+    TMeta desired_meta = make_meta(probe.hash);
 
     size_t target = data_vec_.size();
-    size_t index = pos(desired), offset = index;
+    size_t offset = run(probe, 0u);
     for (size_t count = 0u;
-         (used_vec_[offset] || skip_vec_[offset]) && (count < data_vec_.size());
-         ++count, offset = run(index, count))
+         meta_vec_[offset] != NMetaEmpty && (count < data_vec_.size());
+         ++count, offset = run(probe, count))
     {
-        if (skip_vec_[offset] && (target == data_vec_.size()))
+        if (meta_vec_[offset] == NMetaSkip && (target == data_vec_.size()))
             target = offset;
 
-        if (used_vec_[offset])
+        if (meta_vec_[offset] == desired_meta)
         {
             if (auto& [key, value] = get_data_at(offset); key == desired)
             {
-                value = desired_value;
+                if constexpr (NAssign)
+                    value = (std::forward<Types>(args), ...);
+
                 return false;
             }
         }
     }
 
+    if (is_migrating())
+    {
+        if (size_t found = search_old(probe, desired_meta, desired);
+            found != old_data_vec_.size())
+        {
+            if constexpr (NAssign)
+                get_old_data_at(found).second =
+                    (std::forward<Types>(args), ...);
+
+            return false;
+        }
+    }
+
     if (target == data_vec_.size())
+    {
+        // Probe sequence has met neither a tombstone nor an empty slot, so
+        // the table grows rather than losing the element it ended on
+        if (meta_vec_[offset] != NMetaEmpty)
+        {
+            complete_rehash();
+            rehash(data_vec_.size() * NRehashFactor);
+
+            return emplace_hashed<NAssign>(probe,
+                                           std::forward<TKeyArg>(desired),
+                                           std::forward<Types>(args)...);
+        }
+
         target = offset;
+    }
+    else
+        --skip_count_;
 
-    construct_at(target, desired, desired_value);
-    used_vec_[target] = true;
-    skip_vec_[target] = false;
+    construct_at(target, std::piecewise_construct,
+                 std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                 std::forward_as_tuple(std::forward<Types>(args)...));
+    meta_vec_[target] = desired_meta;
     ++size_;
 
     return true;
 }
 
-template<class TK, class TV>
-bool IOpenAddrHashTable<TK, TV>::
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+bool IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
 erase(const TKey& desired)
 {
-    for (size_t index = pos(desired), offset = index, count = 0u;
-         (used_vec_[offset] || skip_vec_[offset]) && (count < data_vec_.size());
-         ++count, offset = run(index, count))
+    return erase_hashed(pos(desired), desired);
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TKeyLike>
+bool IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+erase_hashed(const SProbe& probe, const TKeyLike& desired)
+{
+    migrate_step();
+
+    TMeta desired_meta = make_meta(probe.hash);
+
+    if (size_t found = search(probe, desired_meta, desired);
+        found != data_vec_.size())
+    {
+        destruct_at(found);
+        meta_vec_[found] = NMetaSkip;
+        --size_;
+        ++skip_count_;
+
+        shrink_on_erase();
+        return true;
+    }
+
+    if (is_migrating())
     {
-        if (auto& [key, value] = get_data_at(offset); 
-            used_vec_[offset] && key == desired)
+        if (size_t found = search_old(probe, desired_meta, desired);
+            found != old_data_vec_.size())
         {
-            destruct_at(offset);
-            used_vec_[offset] = false;
-            skip_vec_[offset] = true;
+            get_old_data_at(found).~TData();
+            old_meta_vec_[found] = NMetaSkip;
             --size_;
 
+            shrink_on_erase();
             return true;
         }
     }
@@ -165,75 +644,508 @@ erase(const TKey& desired)
 }
 
 
-template<class TK, class TV>
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
 std::optional<
     std::reference_wrapper<
-        const typename IOpenAddrHashTable<TK, TV>::TValue
+        const typename IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::TValue
         >
-    > 
-IOpenAddrHashTable<TK, TV>::
-find(const TKey& key) const
+    >
+IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+find(const TKey& desired) const
 {
-    auto result = const_cast<IOpenAddrHashTable&>(*this).find(key);
+    return find_hashed(pos(desired), desired);
+}
 
-    return (result ? 
-            std::make_optional(
-                    std::cref(const_cast<TValue&>(result.value().get()))
-                ) : 
-            std::nullopt);
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TKeyLike>
+std::optional<
+    std::reference_wrapper<
+        const typename IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::TValue
+        >
+    >
+IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+find_hashed(const SProbe& probe, const TKeyLike& desired) const
+{
+    TMeta desired_meta = make_meta(probe.hash);
+
+    if (size_t found = search(probe, desired_meta, desired);
+        found != data_vec_.size())
+        return std::make_optional(std::cref(get_data_at(found).second));
+
+    if (is_migrating())
+    {
+        if (size_t found = search_old(probe, desired_meta, desired);
+            found != old_data_vec_.size())
+            return std::make_optional(std::cref(get_old_data_at(found).second));
+    }
+
+    return std::nullopt;
 }
 
-template<class TK, class TV>
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
 std::optional<
     std::reference_wrapper<
-        typename IOpenAddrHashTable<TK, TV>::TValue
+        typename IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::TValue
         >
-    > 
-IOpenAddrHashTable<TK, TV>::
+    >
+IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
 find(const TKey& desired)
 {
-    for (size_t index = pos(desired), offset = index, count = 0u;
-         (used_vec_[offset] || skip_vec_[offset]) && (count < data_vec_.size());
-         ++count, offset = run(index, count))
+    migrate_step();
+
+    auto result = const_cast<const IOpenAddrHashTable&>(*this).find(desired);
+
+    return (result ?
+            std::make_optional(
+                    std::ref(const_cast<TValue&>(result.value().get()))
+                ) :
+            std::nullopt);
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+insert_batch(const TKey* keys, const TValue* values, size_t count)
+{
+    size_t result = 0u;
+    SProbe probes[NBatchGroup];
+    for (size_t begin = 0u; begin < count; begin += NBatchGroup)
     {
-        if (auto& [key, value] = get_data_at(offset); 
-            used_vec_[offset] && key == desired)
-            return std::ref(value);
+        size_t group = std::min(NBatchGroup, count - begin);
+        prefetch_group(keys + begin, group, probes);
+
+        // Growth in the middle only makes the rest of prefetches useless
+        for (size_t index = 0u; index < group; ++index)
+            result += emplace_hashed<true>(probes[index],
+                                           keys[begin + index],
+                                           values[begin + index]);
     }
 
-    return std::nullopt;
+    return result;
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+erase_batch(const TKey* keys, size_t count)
+{
+    size_t result = 0u;
+    SProbe probes[NBatchGroup];
+    for (size_t begin = 0u; begin < count; begin += NBatchGroup)
+    {
+        size_t group = std::min(NBatchGroup, count - begin);
+        prefetch_group(keys + begin, group, probes);
+
+        for (size_t index = 0u; index < group; ++index)
+            result += erase_hashed(probes[index], keys[begin + index]);
+    }
+
+    return result;
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+find_batch(const TKey* keys, size_t count,
+           std::optional<std::reference_wrapper<TValue>>* results)
+{
+    migrate_steps(count);
+
+    size_t result = 0u;
+    SProbe probes[NBatchGroup];
+    for (size_t begin = 0u; begin < count; begin += NBatchGroup)
+    {
+        size_t group = std::min(NBatchGroup, count - begin);
+        prefetch_group(keys + begin, group, probes);
+
+        for (size_t index = 0u; index < group; ++index)
+        {
+            auto found = find_hashed(probes[index], keys[begin + index]);
+            results[begin + index] = (found ?
+                    std::make_optional(
+                            std::ref(const_cast<TValue&>(found.value().get()))
+                        ) :
+                    std::nullopt);
+            result += found.has_value();
+        }
+    }
+
+    return result;
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+find_batch(const TKey* keys, size_t count,
+           std::optional<std::reference_wrapper<const TValue>>* results) const
+{
+    size_t result = 0u;
+    SProbe probes[NBatchGroup];
+    for (size_t begin = 0u; begin < count; begin += NBatchGroup)
+    {
+        size_t group = std::min(NBatchGroup, count - begin);
+        prefetch_group(keys + begin, group, probes);
+
+        for (size_t index = 0u; index < group; ++index)
+        {
+            results[begin + index] =
+                find_hashed(probes[index], keys[begin + index]);
+            result += results[begin + index].has_value();
+        }
+    }
+
+    return result;
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+prefetch_group(const TKey* keys, size_t count, SProbe* probes) const noexcept
+{
+    for (size_t index = 0u; index < count; ++index)
+    {
+        probes[index] = pos(keys[index]);
+
+        size_t offset = run(probes[index], 0u);
+        prefetch(&meta_vec_[offset]);
+        prefetch(&data_vec_[offset]);
+    }
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TKeyLike>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+search(const SProbe& probe, TMeta desired_meta,
+       const TKeyLike& desired) const noexcept
+{
+    for (size_t offset = run(probe, 0u), count = 0u;
+         meta_vec_[offset] != NMetaEmpty && (count < data_vec_.size());
+         ++count, offset = run(probe, count))
+    {
+        // Fingerprint mismatch rejects the slot without touching its data
+        if (meta_vec_[offset] == desired_meta &&
+            get_data_at(offset).first == desired)
+            return offset;
+    }
+
+    return data_vec_.size();
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TKeyLike>
+size_t IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+search_old(const SProbe& probe, TMeta desired_meta,
+           const TKeyLike& desired) const noexcept
+{
+    size_t old_capacity = old_data_vec_.size();
+    for (size_t offset = run(probe, 0u, old_capacity), count = 0u;
+         old_meta_vec_[offset] != NMetaEmpty && (count < old_capacity);
+         ++count, offset = run(probe, count, old_capacity))
+    {
+        if (old_meta_vec_[offset] == desired_meta &&
+            get_old_data_at(offset).first == desired)
+            return offset;
+    }
+
+    return old_capacity;
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename... Types>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+place(const SProbe& probe, Types&&... args)
+{
+    size_t offset = run(probe, 0u);
+    for (size_t count = 0u; !(meta_vec_[offset] == NMetaEmpty ||
+                              meta_vec_[offset] == NMetaSkip);
+         ++count, offset = run(probe, count))
+        ;
+
+    if (meta_vec_[offset] == NMetaSkip)
+        --skip_count_;
+
+    construct_at(offset, std::forward<Types>(args)...);
+    meta_vec_[offset] = make_meta(probe.hash);
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+migrate(size_t count)
+{
+    if (!is_migrating())
+        return;
+
+    size_t old_capacity = old_data_vec_.size();
+    for (; count > 0u && migrate_pos_ < old_capacity; --count, ++migrate_pos_)
+    {
+        if (is_used(old_meta_vec_[migrate_pos_]))
+        {
+            auto& [key, value] = get_old_data_at(migrate_pos_);
+            place(pos(key), key, std::move(value));
+
+            get_old_data_at(migrate_pos_).~TData();
+            old_meta_vec_[migrate_pos_] = NMetaSkip;
+        }
+    }
+
+    if (migrate_pos_ == old_capacity)
+    {
+        old_meta_vec_ = std::vector<TMeta>();
+        old_data_vec_ = std::vector<TStorage>();
+        migrate_pos_ = 0u;
+    }
+}
+
+// Keys are hashed on all threads and radix partitioned by their first slot,
+// so every partition owns a contiguous region of the table. Threads fill the
+// regions of their partitions without locks, and a key whose probe sequence
+// leaves its region is spilled and inserted once all threads are done. Keys
+// of a partition keep their input order, so the result is the same as of
+// inserting them one by one. Copies of elements must not throw. Every
+// thread hashes with its own copy of the probe, so hashers that keep
+// scratch state, like digest buffers, are not shared between threads.
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TIter>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+build(TIter begin_it, size_t count, size_t thread_count)
+{
+    if (size_ != 0u)
+        throw std::invalid_argument(
+                "IOpenAddrHashTable::build(): "
+                "table is not empty"
+                );
+
+    reserve(count);
+    if (count == 0u)
+        return;
+
+    thread_count = std::max<size_t>(thread_count, 1u);
+
+    size_t capacity = data_vec_.size();
+    size_t part_count = std::min(thread_count * NBuildSplit, capacity);
+    size_t region = (capacity + part_count - 1u) / part_count;
+
+    auto chunk_begin = [count, thread_count](size_t thread) {
+            return count * thread / thread_count;
+        };
+
+    // Per thread counts of keys in every partition, turned into positions
+    // of the thread's keys in `order_vec` below
+    std::vector<SProbe> probe_vec(count);
+    std::vector<size_t> offset_vec(thread_count * part_count, 0u);
+
+    run_threads(thread_count, [&](size_t thread) {
+            const TProbe probe = probe_;
+            size_t* offsets = &offset_vec[thread * part_count];
+            for (size_t index = chunk_begin(thread);
+                 index < chunk_begin(thread + 1u); ++index)
+            {
+                probe_vec[index] = probe.pos(begin_it[index].first);
+                ++offsets[run(probe_vec[index], 0u, capacity) / region];
+            }
+        });
+
+    std::vector<size_t> part_begin_vec(part_count + 1u);
+    for (size_t part = 0u, offset = 0u; part < part_count; ++part)
+    {
+        part_begin_vec[part] = offset;
+        for (size_t thread = 0u; thread < thread_count; ++thread)
+        {
+            size_t part_size = offset_vec[thread * part_count + part];
+            offset_vec[thread * part_count + part] = offset;
+            offset += part_size;
+        }
+    }
+
+    part_begin_vec[part_count] = count;
+
+    std::vector<size_t> order_vec(count);
+    run_threads(thread_count, [&](size_t thread) {
+            size_t* offsets = &offset_vec[thread * part_count];
+            for (size_t index = chunk_begin(thread);
+                 index < chunk_begin(thread + 1u); ++index)
+            {
+                size_t part = run(probe_vec[index], 0u, capacity) / region;
+                order_vec[offsets[part]++] = index;
+            }
+        });
+
+    std::vector<std::vector<size_t>> spill_vec(part_count);
+    std::atomic<size_t> next_part{};
+    std::atomic<size_t> placed{};
+
+    run_threads(thread_count, [&](size_t) {
+            size_t local_placed = 0u;
+            for (size_t part = next_part.fetch_add(1u);
+                 part < part_count; part = next_part.fetch_add(1u))
+            {
+                size_t region_begin = part * region;
+                size_t region_end = std::min(region_begin + region, capacity);
+
+                for (size_t at = part_begin_vec[part];
+                     at < part_begin_vec[part + 1u]; ++at)
+                {
+                    size_t index = order_vec[at];
+                    const auto& [key, value] = begin_it[index];
+                    const SProbe& probe = probe_vec[index];
+                    TMeta desired_meta = make_meta(probe.hash);
+
+                    size_t offset = run(probe, 0u);
+                    for (size_t step = 0u; ; offset = run(probe, ++step))
+                    {
+                        if (offset < region_begin || offset >= region_end ||
+                            step == region)
+                        {
+                            spill_vec[part].push_back(index);
+                            break;
+                        }
+
+                        if (meta_vec_[offset] == NMetaEmpty)
+                        {
+                            construct_at(offset, key, value);
+                            meta_vec_[offset] = desired_meta;
+                            ++local_placed;
+                            break;
+                        }
+
+                        if (meta_vec_[offset] == desired_meta &&
+                            get_data_at(offset).first == key)
+                        {
+                            get_data_at(offset).second = value;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            placed.fetch_add(local_placed);
+        });
+
+    size_ = placed.load();
+
+    // Table is presized, so spilled keys never cause a rehash
+    for (const auto& spilled : spill_vec)
+    {
+        for (size_t index : spilled)
+        {
+            const auto& [key, value] = begin_it[index];
+            emplace_hashed<true>(probe_vec[index], key, value);
+        }
+    }
 }
 
-template<class TK, class TV>
-void IOpenAddrHashTable<TK, TV>::
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+template<typename TFunc>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+run_threads(size_t thread_count, const TFunc& func)
+{
+    std::vector<std::thread> thread_vec;
+    thread_vec.reserve(thread_count - 1u);
+    for (size_t thread = 1u; thread < thread_count; ++thread)
+        thread_vec.emplace_back(func, thread);
+
+    func(0u);
+
+    for (std::thread& thread : thread_vec)
+        thread.join();
+}
+
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
 rehash(size_t new_capacity)
 {
-    if (new_capacity <= data_vec_.size())
+    // Shrinking is fine as long as every element keeps a slot
+    if (new_capacity < size_ || new_capacity == 0u)
         throw std::invalid_argument(
                 "IOpenAddrHashTable::rehash(): "
-                "new_capacity <= data_vec_.size()"
+                "new_capacity < size_"
                 );
 
-    auto old_used_vec = std::vector<bool>(new_capacity);
+    complete_rehash();
+
+    auto old_meta_vec = std::vector<TMeta>(new_capacity, NMetaEmpty);
     auto old_data_vec = std::vector<TStorage>(new_capacity);
 
-    skip_vec_ = std::vector<bool>(new_capacity, false);
-    std::swap(used_vec_, old_used_vec);
+    std::swap(meta_vec_, old_meta_vec);
     std::swap(data_vec_, old_data_vec);
+    skip_count_ = 0u;
+
+    if constexpr (TRehash::NMigrateStep != 0u)
+    {
+        old_meta_vec_ = std::move(old_meta_vec);
+        old_data_vec_ = std::move(old_data_vec);
+        migrate_pos_ = 0u;
+
+        return;
+    }
 
-    size_ = 0u;
     for (size_t index = 0u; index < old_data_vec.size(); ++index)
     {
-        if (old_used_vec[index])
+        if (is_used(old_meta_vec[index]))
         {
-            TData* ptr = 
+            TData* ptr =
                 std::launder(reinterpret_cast<TData*>(&old_data_vec[index]));
 
-            auto&& [key, value] = std::move(*ptr);
-            insert(std::move(key), std::move(value));
+            auto& [key, value] = *ptr;
+            place(pos(key), key, std::move(value));
 
             ptr->~TData();
-            old_used_vec[index] = false;
+        }
+    }
+}
+
+// Drops all tombstones without reallocation: every used slot is marked as
+// pending and then moved to the first slot of its probe sequence that is not
+// already taken by a placed key, swapping with a pending key if needed
+template<class TK, class TV, class TP, size_t NLR, class TC, class TR, class TS>
+void IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>::
+cleanup()
+{
+    for (auto& meta : meta_vec_)
+    {
+        if (meta == NMetaSkip)
+            meta = NMetaEmpty;
+        else if (is_used(meta))
+            meta |= NMetaPending;
+    }
+
+    skip_count_ = 0u;
+
+    TStorage buffer;
+    for (size_t index = 0u; index < meta_vec_.size(); ++index)
+    {
+        while ((meta_vec_[index] & NMetaStateMask) == NMetaPending)
+        {
+            SProbe probe = pos(get_data_at(index).first);
+
+            size_t target = run(probe, 0u);
+            for (size_t count = 0u;
+                 (meta_vec_[target] & NMetaStateMask) == NMetaUsed;
+                 ++count, target = run(probe, count))
+                ;
+
+            TMeta meta = meta_vec_[index] & ~NMetaSkip;
+            if (target == index)
+            {
+                meta_vec_[index] = meta;
+            }
+            else if (meta_vec_[target] == NMetaEmpty)
+            {
+                construct_at(target, std::move(get_data_at(index)));
+                destruct_at(index);
+
+                meta_vec_[target] = meta;
+                meta_vec_[index] = NMetaEmpty;
+            }
+            else
+            {
+                // Pending key from the target comes here and is placed next
+                TData* tmp =
+                    new (&buffer) TData{ std::move(get_data_at(index)) };
+                destruct_at(index);
+                construct_at(index, std::move(get_data_at(target)));
+                destruct_at(target);
+                construct_at(target, std::move(*tmp));
+                tmp->~TData();
+
+                meta_vec_[index] = meta_vec_[target];
+                meta_vec_[target] = meta;
+            }
         }
     }
 }
@@ -0,0 +1,556 @@
+#ifndef LOCK_FREE_HASHTABLE_H_
+#define LOCK_FREE_HASHTABLE_H_
+
+#include "ThreadIndex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Lock-free linear probing for integral keys and small trivially copyable
+// values in the style of Junction's Linear map. Keys are claimed with CAS
+// and never removed from a table, erase only clears the value, so a probe
+// sequence never breaks. Values live in a 64-bit word together with state
+// bits and are published with release CAS.
+//
+// Resize freezes every value word of the old table so writers can not
+// change it anymore. Writers that meet a frozen word or a pending resize
+// help to copy chunks of slots. Once all chunks are handed out, helpers
+// copy again every chunk not finished yet instead of waiting for the
+// thread that took it, so a stalled thread holds up no writer. Readers
+// never block and read the old table until the new one is published.
+//
+// Every operation announces the current epoch in its own slot, and
+// a replaced table is freed once no operation may still be in an epoch
+// that could have seen it. Slots are given back when threads exit, threads
+// beyond NThreads running at once share a counter instead, which holds off
+// freeing while any of them runs.
+//
+// As values may change concurrently find() returns a copy, so the table
+// does not implement IHashTable.
+template<class TK, class TV, class TH = std::hash<TK>,
+         size_t NThreads = 128u>
+class CLockFreeHashTable final
+{
+public:
+    using TKey = TK;
+    using TValue = TV;
+    using THasher = TH;
+
+    static_assert(std::is_integral_v<TKey> && sizeof(TKey) <= 8u,
+                  "key must be an integer of at most 64 bits");
+    static_assert(std::is_trivially_copyable_v<TValue> &&
+                  sizeof(TValue) <= 4u,
+                  "value must be trivially copyable of at most 32 bits");
+
+    // All bits set key is reserved for empty slots
+    static constexpr uint64_t NKeyEmpty = ~uint64_t{ 0u };
+
+    // Value word is the value in the low 32 bits and state above them,
+    // a word without NValuePresent is an absent value. Zero word is left
+    // only in slots never written, erase leaves NValueErased.
+    static constexpr uint64_t NValuePresent = uint64_t{ 1u } << 32u;
+    static constexpr uint64_t NValueFrozen = uint64_t{ 1u } << 33u;
+    static constexpr uint64_t NValueErased = uint64_t{ 1u } << 34u;
+    static constexpr uint64_t NValueMask = NValuePresent - 1u;
+
+    static constexpr size_t NStartCapacity = 64u;
+    // Resize when 75% of slots have keys, erased ones included
+    static constexpr size_t NLoadRatio = 4u;
+    static constexpr double NRehashFactor = 2.0;
+
+    // Slots copied by a helper at a time
+    static constexpr size_t NMigrateChunk = 1024u;
+
+    // Thread slot value of a thread outside of an operation
+    static constexpr uint64_t NEpochIdle = 0u;
+
+    CLockFreeHashTable():
+        first_table_(new STable(NStartCapacity)),
+        table_(first_table_)
+    {}
+
+    CLockFreeHashTable(const CLockFreeHashTable&) = delete;
+    CLockFreeHashTable& operator = (const CLockFreeHashTable&) = delete;
+
+    // Requires no operation to be running. Replaced tables not freed yet
+    // are still linked through `next` from the first one.
+    ~CLockFreeHashTable()
+    {
+        for (STable* table = first_table_; table != nullptr; )
+        {
+            STable* next = table->next.load(std::memory_order_relaxed);
+            delete table;
+            table = next;
+        }
+    }
+
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept
+    {
+        COpGuard guard(*this);
+        return table_.load(std::memory_order_seq_cst)->mask + 1u;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return size() == 0u;
+    }
+
+    // Inserts or assigns, returns true if the key was not present
+    bool insert(const TKey& desired, const TValue& desired_value)
+    {
+        uint64_t key = static_cast<uint64_t>(desired);
+        if (key == NKeyEmpty)
+            throw std::invalid_argument(
+                    "CLockFreeHashTable::insert(): "
+                    "key is reserved for empty slots"
+                    );
+
+        COpGuard guard(*this);
+        uint64_t word = encode(desired_value);
+        for (;;)
+        {
+            STable* table = table_.load(std::memory_order_seq_cst);
+            if (table->next.load(std::memory_order_acquire) != nullptr)
+            {
+                help_migrate(table);
+                continue;
+            }
+
+            size_t index = claim(table, key);
+            if (index > table->mask)
+            {
+                start_migrate(table);
+                help_migrate(table);
+                continue;
+            }
+
+            auto& value = table->slot_vec[index].value;
+            uint64_t current = value.load(std::memory_order_relaxed);
+            while ((current & NValueFrozen) == 0u &&
+                   !value.compare_exchange_weak(current, word,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+                ;
+
+            if ((current & NValueFrozen) != 0u)
+            {
+                help_migrate(table);
+                continue;
+            }
+
+            if ((current & NValuePresent) != 0u)
+                return false;
+
+            size_.fetch_add(1u, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    bool erase(const TKey& desired)
+    {
+        uint64_t key = static_cast<uint64_t>(desired);
+        if (key == NKeyEmpty)
+            return false;
+
+        COpGuard guard(*this);
+        for (;;)
+        {
+            STable* table = table_.load(std::memory_order_seq_cst);
+            if (table->next.load(std::memory_order_acquire) != nullptr)
+            {
+                help_migrate(table);
+                continue;
+            }
+
+            size_t index = search(table, key);
+            if (index > table->mask)
+                return false;
+
+            auto& value = table->slot_vec[index].value;
+            uint64_t current = value.load(std::memory_order_relaxed);
+            while ((current & NValueFrozen) == 0u &&
+                   (current & NValuePresent) != 0u &&
+                   !value.compare_exchange_weak(current, NValueErased,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+                ;
+
+            if ((current & NValueFrozen) != 0u)
+            {
+                help_migrate(table);
+                continue;
+            }
+
+            if ((current & NValuePresent) == 0u)
+                return false;
+
+            size_.fetch_sub(1u, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Frozen values are still valid until the new table is published
+    [[nodiscard]]
+    std::optional<TValue> find(const TKey& desired) const noexcept
+    {
+        uint64_t key = static_cast<uint64_t>(desired);
+        if (key == NKeyEmpty)
+            return std::nullopt;
+
+        COpGuard guard(*this);
+        const STable* table = table_.load(std::memory_order_seq_cst);
+        size_t index = search(table, key);
+        if (index > table->mask)
+            return std::nullopt;
+
+        uint64_t current =
+            table->slot_vec[index].value.load(std::memory_order_acquire);
+        if ((current & NValuePresent) == 0u)
+            return std::nullopt;
+
+        return decode(current);
+    }
+
+protected:
+    struct SSlot
+    {
+        std::atomic<uint64_t> key{ NKeyEmpty };
+        std::atomic<uint64_t> value{};
+    };
+
+    struct STable
+    {
+        explicit STable(size_t capacity):
+            mask(capacity - 1u),
+            slot_vec(capacity),
+            chunk_done_vec((capacity + NMigrateChunk - 1u) / NMigrateChunk)
+        {}
+
+        size_t mask;
+        std::vector<SSlot> slot_vec;
+
+        // Slots with a key, erased ones included
+        std::atomic<size_t> used{};
+
+        // Set once when the resize starts
+        std::atomic<STable*> next{};
+        // Next chunk to hand out and chunks copied in full by someone
+        std::atomic<size_t> migrate_pos{};
+        std::vector<std::atomic<bool>> chunk_done_vec;
+
+        // Epoch in which the table was replaced, idle until then
+        std::atomic<uint64_t> retire_epoch{ NEpochIdle };
+    };
+
+    // Each slot takes its own cache line, so threads do not false share
+    struct alignas(64) SThread
+    {
+        std::atomic<uint64_t> epoch{ NEpochIdle };
+    };
+
+    // Announces the epoch before the operation loads the table. Store of
+    // the epoch and the table loads are all sequentially consistent, so
+    // either reclaim() sees the announcement or the operation sees the
+    // table that replaced a retired one.
+    class COpGuard
+    {
+    public:
+        explicit COpGuard(const CLockFreeHashTable& table) noexcept:
+            table_(table),
+            thread_(table.thread_slot())
+        {
+            if (thread_ != nullptr)
+                thread_->epoch.store(
+                        table_.epoch_.load(std::memory_order_acquire),
+                        std::memory_order_seq_cst);
+            else
+                table_.guests_.fetch_add(1u, std::memory_order_seq_cst);
+        }
+
+        COpGuard(const COpGuard&) = delete;
+        COpGuard& operator = (const COpGuard&) = delete;
+
+        ~COpGuard()
+        {
+            if (thread_ != nullptr)
+                thread_->epoch.store(NEpochIdle, std::memory_order_release);
+            else
+                table_.guests_.fetch_sub(1u, std::memory_order_release);
+        }
+
+    private:
+        const CLockFreeHashTable& table_;
+        SThread* thread_;
+    };
+
+    // Slot of the calling thread, the same in every table of this type;
+    // nullptr if all of them are taken by running threads
+    [[nodiscard]]
+    SThread* thread_slot() const noexcept
+    {
+        size_t index = CThreadIndex<CLockFreeHashTable, NThreads>::get();
+
+        return (index < NThreads ? &thread_vec_[index] : nullptr);
+    }
+
+    [[nodiscard]]
+    static inline uint64_t encode(const TValue& value) noexcept
+    {
+        uint32_t bits = 0u;
+        std::memcpy(&bits, &value, sizeof(TValue));
+
+        return NValuePresent | bits;
+    }
+
+    [[nodiscard]]
+    static inline TValue decode(uint64_t word) noexcept
+    {
+        uint32_t bits = static_cast<uint32_t>(word & NValueMask);
+
+        TValue value;
+        std::memcpy(&value, &bits, sizeof(TValue));
+
+        return value;
+    }
+
+    // Hashers like std::hash may be identity, so the hash is mixed to
+    // spread sequential keys over the table
+    [[nodiscard]]
+    inline size_t home_of(const STable* table, uint64_t key) const noexcept
+    {
+        uint64_t hash = static_cast<uint64_t>(
+                hasher_(static_cast<TKey>(key)));
+        hash ^= hash >> 33u;
+        hash *= 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 33u;
+
+        return static_cast<size_t>(hash) & table->mask;
+    }
+
+    // Returns the slot with `key` or capacity if none
+    [[nodiscard]]
+    size_t search(const STable* table, uint64_t key) const noexcept
+    {
+        size_t index = home_of(table, key);
+        for (size_t probe = 0u; probe <= table->mask; ++probe)
+        {
+            uint64_t current =
+                table->slot_vec[index].key.load(std::memory_order_acquire);
+            if (current == key)
+                return index;
+            if (current == NKeyEmpty)
+                break;
+
+            index = (index + 1u) & table->mask;
+        }
+
+        return table->mask + 1u;
+    }
+
+    // Returns the slot with `key`, claiming an empty one if needed, or
+    // capacity if the table is full
+    [[nodiscard]]
+    size_t claim(STable* table, uint64_t key)
+    {
+        size_t index = home_of(table, key);
+        for (size_t probe = 0u; probe <= table->mask; ++probe)
+        {
+            auto& slot_key = table->slot_vec[index].key;
+            uint64_t current = slot_key.load(std::memory_order_acquire);
+            if (current == NKeyEmpty &&
+                slot_key.compare_exchange_strong(current, key,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire))
+            {
+                size_t capacity = table->mask + 1u;
+                size_t used =
+                    table->used.fetch_add(1u, std::memory_order_relaxed) + 1u;
+
+                // The slot stays usable until the resize freezes it
+                if (capacity * (NLoadRatio - 1) < used * NLoadRatio)
+                    start_migrate(table);
+
+                return index;
+            }
+
+            if (current == key)
+                return index;
+
+            index = (index + 1u) & table->mask;
+        }
+
+        return table->mask + 1u;
+    }
+
+    // Copying skips erased keys, so a table full of them is rebuilt in
+    // place of growing. The new table is never smaller than the old one,
+    // so it has a slot for every key copied.
+    void start_migrate(STable* table)
+    {
+        if (table->next.load(std::memory_order_acquire) != nullptr)
+            return;
+
+        size_t capacity = table->mask + 1u;
+        size_t size = size_.load(std::memory_order_relaxed);
+        size_t new_capacity = (capacity * (NLoadRatio - 1) <
+                               2u * size * NLoadRatio ?
+                               capacity * NRehashFactor : capacity);
+
+        STable* expected = nullptr;
+        STable* new_table = new STable(new_capacity);
+        if (!table->next.compare_exchange_strong(expected, new_table,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire))
+            delete new_table;
+    }
+
+    // Copies chunks until none is left to hand out, then copies again
+    // every chunk nobody has finished yet. When all of them are done, no
+    // matter by whom, the new table is complete and may be published.
+    void help_migrate(STable* table)
+    {
+        STable* new_table = table->next.load(std::memory_order_acquire);
+        size_t chunk_count = table->chunk_done_vec.size();
+
+        for (;;)
+        {
+            size_t chunk =
+                table->migrate_pos.fetch_add(1u, std::memory_order_relaxed);
+            if (chunk >= chunk_count)
+                break;
+
+            migrate_chunk(table, new_table, chunk);
+        }
+
+        for (size_t chunk = 0u; chunk < chunk_count; ++chunk)
+        {
+            if (table_.load(std::memory_order_seq_cst) != table)
+                return;
+
+            if (!table->chunk_done_vec[chunk].load(std::memory_order_acquire))
+                migrate_chunk(table, new_table, chunk);
+        }
+
+        publish(table, new_table);
+    }
+
+    // Operations that announce a later epoch load the new table
+    void publish(STable* table, STable* new_table)
+    {
+        if (!table_.compare_exchange_strong(table, new_table,
+                                            std::memory_order_seq_cst))
+            return;
+
+        uint64_t epoch = epoch_.fetch_add(1u, std::memory_order_seq_cst);
+        table->retire_epoch.store(epoch, std::memory_order_release);
+
+        reclaim();
+    }
+
+    // Frees replaced tables at the front of the chain retired before
+    // the oldest epoch still announced. One thread at a time walks the
+    // chain, the others skip it and leave the tables to the next resize.
+    void reclaim() noexcept
+    {
+        if (reclaiming_.test_and_set(std::memory_order_acquire))
+            return;
+
+        if (guests_.load(std::memory_order_seq_cst) == 0u)
+        {
+            uint64_t min_epoch = epoch_.load(std::memory_order_seq_cst);
+            for (const SThread& thread : thread_vec_)
+            {
+                uint64_t epoch = thread.epoch.load(std::memory_order_seq_cst);
+                if (epoch != NEpochIdle && epoch < min_epoch)
+                    min_epoch = epoch;
+            }
+
+            while (first_table_ != table_.load(std::memory_order_seq_cst))
+            {
+                uint64_t epoch =
+                    first_table_->retire_epoch.load(std::memory_order_acquire);
+                if (epoch == NEpochIdle || epoch >= min_epoch)
+                    break;
+
+                STable* next =
+                    first_table_->next.load(std::memory_order_acquire);
+                delete first_table_;
+                first_table_ = next;
+            }
+        }
+
+        reclaiming_.clear(std::memory_order_release);
+    }
+
+    void migrate_chunk(STable* table, STable* new_table, size_t chunk)
+    {
+        size_t begin = chunk * NMigrateChunk;
+        size_t end = std::min(begin + NMigrateChunk, table->mask + 1u);
+
+        for (size_t index = begin; index < end; ++index)
+        {
+            SSlot& slot = table->slot_vec[index];
+
+            // Key is stored before the value is published, so acquire on
+            // the value makes it visible
+            uint64_t current =
+                slot.value.fetch_or(NValueFrozen, std::memory_order_acq_rel);
+            if ((current & NValuePresent) == 0u)
+                continue;
+
+            uint64_t key = slot.key.load(std::memory_order_relaxed);
+
+            size_t new_index = claim(new_table, key);
+            if (new_index > new_table->mask)
+                throw std::length_error(
+                        "CLockFreeHashTable::migrate_chunk(): "
+                        "new table is full"
+                        );
+
+            // A chunk may be copied by several helpers, and a late one may
+            // come after the new table is published. Only a never written
+            // value is filled, so later updates are never overwritten.
+            uint64_t expected = 0u;
+            new_table->slot_vec[new_index].value.compare_exchange_strong(
+                    expected, current & ~NValueFrozen,
+                    std::memory_order_relaxed, std::memory_order_relaxed);
+        }
+
+        table->chunk_done_vec[chunk].store(true, std::memory_order_release);
+    }
+
+private:
+    std::atomic<size_t> size_{};
+    THasher hasher_{};
+
+    // Oldest table not freed yet, changed only by reclaim()
+    STable* first_table_;
+    std::atomic<STable*> table_;
+
+    std::atomic<uint64_t> epoch_{ NEpochIdle + 1u };
+    mutable std::vector<SThread> thread_vec_ =
+        std::vector<SThread>(NThreads);
+    mutable std::atomic<size_t> guests_{};
+    std::atomic_flag reclaiming_ = ATOMIC_FLAG_INIT;
+};
+
+} // namespace
+
+#endif // LOCK_FREE_HASHTABLE_H_
@@ -0,0 +1,589 @@
+#ifndef MAPPED_HASHTABLE_H_
+#define MAPPED_HASHTABLE_H_
+
+#include "IOpenAddrHashTable.h"
+#include "CuckooHashTable.h"
+
+#include <new>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// File layout of a saved table. Every array starts at a multiple of
+// NMappedAlign from the file start, so it is aligned once mapped.
+//
+//   SMappedHeader | states[slot_count] | data[slot_count] | stash[stash_count]
+//
+// States and data are the table storage as is, unused data slots are
+// zeroed. Integers are in host byte order, a foreign file fails the
+// magic check.
+struct SMappedHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t data_size;
+    uint32_t data_align;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t slot_count;
+    uint64_t stash_count;
+    uint64_t state_offset;
+    uint64_t data_offset;
+    uint64_t stash_offset;
+    uint64_t file_size;
+};
+
+// "HASHMAP1" read as a little endian integer
+static constexpr uint64_t NMappedMagic = 0x3150414D48534148u;
+static constexpr uint32_t NMappedVersion = 1u;
+static constexpr size_t NMappedAlign = 64u;
+
+// Layouts know the storage of one table family, both in memory and as
+// mapped arrays. Lookups repeat the ones of the table over the arrays.
+template<class TTable>
+class COpenAddrLayout
+{
+public:
+    using TKey = typename TTable::TKey;
+    using TData = typename TTable::TData;
+    using TProbe = typename TTable::TProbe;
+    using TState = typename TTable::TMeta;
+
+    static constexpr uint32_t NLayoutId = 1u;
+
+    // Saved storage must not be split between old and new arrays
+    static void prepare(TTable& table)
+    {
+        table.complete_rehash();
+    }
+
+    [[nodiscard]]
+    static size_t capacity(const TTable& table) noexcept
+    {
+        return table.data_vec_.size();
+    }
+
+    [[nodiscard]]
+    static size_t slot_count(const TTable& table) noexcept
+    {
+        return table.data_vec_.size();
+    }
+
+    [[nodiscard]]
+    static TState state_at(const TTable& table, size_t index) noexcept
+    {
+        return table.meta_vec_[index];
+    }
+
+    [[nodiscard]]
+    static bool is_used(TState state) noexcept
+    {
+        return TTable::is_used(state);
+    }
+
+    [[nodiscard]]
+    static const TData& data_at(const TTable& table, size_t index) noexcept
+    {
+        return table.get_data_at(index);
+    }
+
+    [[nodiscard]]
+    static std::vector<const TData*> stash(const TTable&)
+    {
+        return {};
+    }
+
+    [[nodiscard]]
+    const TData* find(const TKey& desired, const TState* states,
+                      const TData* data, size_t capacity,
+                      const TData*, size_t) const noexcept
+    {
+        auto probe = probe_.pos(desired);
+        TState desired_meta = TTable::make_meta(probe.hash);
+
+        for (size_t offset = TTable::run(probe, 0u, capacity), count = 0u;
+             states[offset] != TTable::NMetaEmpty && (count < capacity);
+             ++count, offset = TTable::run(probe, count, capacity))
+        {
+            if (states[offset] == desired_meta && data[offset].first == desired)
+                return &data[offset];
+        }
+
+        return nullptr;
+    }
+
+private:
+    TProbe probe_{};
+};
+
+template<class TTable>
+class CCuckooLayout
+{
+public:
+    using TKey = typename TTable::TKey;
+    using TData = typename TTable::TData;
+    using TCapacity = typename TTable::TCapacity;
+    using TState = uint8_t;
+
+    static constexpr uint32_t NLayoutId = 2u;
+
+    static void prepare(TTable& table)
+    {
+        table.complete_rehash();
+    }
+
+    [[nodiscard]]
+    static size_t capacity(const TTable& table) noexcept
+    {
+        return table.capacity();
+    }
+
+    // Left half of the slots is indexed by the left hasher
+    [[nodiscard]]
+    static size_t slot_count(const TTable& table) noexcept
+    {
+        return table.data_vec_.size();
+    }
+
+    [[nodiscard]]
+    static TState state_at(const TTable& table, size_t index) noexcept
+    {
+        return static_cast<TState>(table.used_vec_[index]);
+    }
+
+    [[nodiscard]]
+    static bool is_used(TState state) noexcept
+    {
+        return state != 0u;
+    }
+
+    [[nodiscard]]
+    static const TData& data_at(const TTable& table, size_t index) noexcept
+    {
+        return table.get_data_at(index);
+    }
+
+    // Only used stash entries are saved, packed, followed by the overflow
+    // list, which is searched the same way
+    [[nodiscard]]
+    static std::vector<const TData*> stash(const TTable& table)
+    {
+        std::vector<const TData*> result;
+        for (size_t index = 0u; index < TTable::NStashSize; ++index)
+        {
+            if (table.stash_used_vec_[index])
+                result.push_back(&table.get_stash_at(index));
+        }
+
+        for (const TData& data : table.overflow_list_)
+            result.push_back(&data);
+
+        return result;
+    }
+
+    [[nodiscard]]
+    const TData* find(const TKey& desired, const TState* states,
+                      const TData* data, size_t capacity,
+                      const TData* stash, size_t stash_count) const noexcept
+    {
+        size_t left_index = TCapacity::index(left_hasher_(desired), capacity);
+        if (states[left_index] != 0u && data[left_index].first == desired)
+            return &data[left_index];
+
+        size_t right_index = TCapacity::index(
+                TTable::mix(right_hasher_(desired)), capacity) + capacity;
+        if (states[right_index] != 0u && data[right_index].first == desired)
+            return &data[right_index];
+
+        for (size_t index = 0u; index < stash_count; ++index)
+        {
+            if (stash[index].first == desired)
+                return &stash[index];
+        }
+
+        return nullptr;
+    }
+
+private:
+    typename TTable::TLeftHasher left_hasher_{};
+    typename TTable::TRightHasher right_hasher_{};
+};
+
+// Concrete open addressing tables only derive from IOpenAddrHashTable
+template<class TTable>
+struct SIsOpenAddr
+{
+    template<class TK, class TV, class TP, size_t NLR,
+             class TC, class TR, class TS>
+    static std::true_type check(
+            const IOpenAddrHashTable<TK, TV, TP, NLR, TC, TR, TS>*);
+    static std::false_type check(const void*);
+
+    static constexpr bool value =
+        decltype(check(std::declval<TTable*>()))::value;
+};
+
+template<class TTable>
+struct SIsCuckoo : std::false_type {};
+
+template<class TK, class TV, class TLH, class TRH,
+         class TC, class TR, class TS>
+struct SIsCuckoo<CCuckooHashTable<TK, TV, TLH, TRH, TC, TR, TS>> :
+    std::true_type
+{};
+
+template<class TTable>
+using TMappedLayout = std::conditional_t<SIsCuckoo<TTable>::value,
+                                         CCuckooLayout<TTable>,
+                                         COpenAddrLayout<TTable>>;
+
+// Read-only table over a file written by save(). The file is mapped
+// shared, so lookups read the page cache directly and every process
+// mapping the same file shares one copy of it. Opening does no
+// deserialization and no rehash, pages are read as lookups touch them.
+//
+// The file is only valid for the very table type and hasher that saved
+// it: hashers are default constructed on both sides, so a hasher with
+// per-process state, e.g. a random seed, can not be used.
+template<class TTable>
+class CMappedHashTable final
+{
+public:
+    using TTableType = TTable;
+    using TKey = typename TTable::TKey;
+    using TValue = typename TTable::TValue;
+    using TData = typename TTable::TData;
+    using TLayout = TMappedLayout<TTable>;
+    using TState = typename TLayout::TState;
+
+    static_assert(SIsCuckoo<TTable>::value || SIsOpenAddr<TTable>::value,
+                  "only open addressing and cuckoo tables can be mapped");
+    static_assert(std::is_trivially_copyable_v<std::remove_cv_t<TKey>> &&
+                  std::is_trivially_copyable_v<TValue>,
+                  "key and value must be trivially copyable");
+
+    explicit CMappedHashTable(const std::string& path);
+
+    CMappedHashTable(const CMappedHashTable&) = delete;
+    CMappedHashTable& operator = (const CMappedHashTable&) = delete;
+
+    CMappedHashTable(CMappedHashTable&& other) noexcept
+    {
+        swap(other);
+    }
+
+    CMappedHashTable& operator = (CMappedHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~CMappedHashTable()
+    {
+        if (base_ != nullptr)
+            munmap(base_, length_);
+    }
+
+    // Completes an incremental rehash of `table` first. The file is
+    // written aside and renamed over `path`, so processes that still map
+    // the old file keep reading it unchanged.
+    static void save(TTable& table, const std::string& path);
+
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        return header_->size;
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept
+    {
+        return header_->capacity;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return size() == 0u;
+    }
+
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const noexcept
+    {
+        if (const TData* data = layout_.find(desired, state_, data_,
+                                             header_->capacity, stash_,
+                                             header_->stash_count))
+            return std::make_optional(std::cref(data->second));
+
+        return std::nullopt;
+    }
+
+protected:
+    [[nodiscard]]
+    static constexpr uint64_t align_up(uint64_t offset) noexcept
+    {
+        return (offset + NMappedAlign - 1u) / NMappedAlign * NMappedAlign;
+    }
+
+    // Header fields that depend on the table type only
+    [[nodiscard]]
+    static SMappedHeader type_header() noexcept;
+
+    [[nodiscard]]
+    static SMappedHeader make_header(const TTable& table,
+                                     size_t stash_count) noexcept;
+
+    // Rejects files of another table type or build, and truncated ones
+    void validate(const std::string& path) const;
+
+    void swap(CMappedHashTable& other) noexcept
+    {
+        std::swap(base_, other.base_);
+        std::swap(length_, other.length_);
+        std::swap(header_, other.header_);
+        std::swap(state_, other.state_);
+        std::swap(data_, other.data_);
+        std::swap(stash_, other.stash_);
+    }
+
+private:
+    TLayout layout_{};
+
+    void* base_{};
+    size_t length_{};
+
+    const SMappedHeader* header_{};
+    const TState* state_{};
+    const TData* data_{};
+    const TData* stash_{};
+};
+
+template<class TTable>
+CMappedHashTable<TTable>::
+CMappedHashTable(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(
+                "CMappedHashTable::CMappedHashTable(): can not open " + path);
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < sizeof(SMappedHeader))
+    {
+        close(fd);
+        throw std::runtime_error(
+                "CMappedHashTable::CMappedHashTable(): "
+                "file is too short " + path);
+    }
+
+    length_ = static_cast<size_t>(file_stat.st_size);
+    void* base = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        throw std::runtime_error(
+                "CMappedHashTable::CMappedHashTable(): can not map " + path);
+
+    // Lookups jump all over the file, read-ahead would only waste I/O
+    base_ = base;
+    madvise(base_, length_, MADV_RANDOM);
+
+    const auto* bytes = static_cast<const unsigned char*>(base_);
+    header_ = reinterpret_cast<const SMappedHeader*>(bytes);
+    state_ = reinterpret_cast<const TState*>(bytes + header_->state_offset);
+    data_ = std::launder(
+            reinterpret_cast<const TData*>(bytes + header_->data_offset));
+    stash_ = std::launder(
+            reinterpret_cast<const TData*>(bytes + header_->stash_offset));
+
+    try
+    {
+        validate(path);
+    }
+    catch (...)
+    {
+        munmap(base_, length_);
+        throw;
+    }
+}
+
+template<class TTable>
+void CMappedHashTable<TTable>::
+validate(const std::string& path) const
+{
+    const SMappedHeader& header = *header_;
+    SMappedHeader expected = type_header();
+
+    if (header.magic != expected.magic ||
+        header.version != expected.version ||
+        header.layout != expected.layout ||
+        header.key_size != expected.key_size ||
+        header.value_size != expected.value_size ||
+        header.data_size != expected.data_size ||
+        header.data_align != expected.data_align)
+        throw std::invalid_argument(
+                "CMappedHashTable::validate(): "
+                "file is not of this table type " + path);
+
+    uint64_t data_end =
+        header.data_offset + header.slot_count * sizeof(TData);
+    if (header.file_size != length_ || header.capacity == 0u ||
+        header.state_offset % NMappedAlign != 0u ||
+        header.data_offset % NMappedAlign != 0u ||
+        header.stash_offset % NMappedAlign != 0u ||
+        header.state_offset + header.slot_count * sizeof(TState) >
+            header.data_offset ||
+        data_end > header.stash_offset ||
+        header.stash_offset + header.stash_count * sizeof(TData) >
+            length_)
+        throw std::invalid_argument(
+                "CMappedHashTable::validate(): "
+                "file is truncated or corrupt " + path);
+
+    // Any stored key must be found again, otherwise the hasher differs
+    for (size_t index = 0u; index < header.slot_count; ++index)
+    {
+        if (!TLayout::is_used(state_[index]))
+            continue;
+
+        if (layout_.find(data_[index].first, state_, data_, header.capacity,
+                         stash_, header.stash_count) != &data_[index])
+            throw std::invalid_argument(
+                    "CMappedHashTable::validate(): "
+                    "file was saved with another hasher " + path);
+
+        break;
+    }
+}
+
+template<class TTable>
+SMappedHeader CMappedHashTable<TTable>::
+type_header() noexcept
+{
+    SMappedHeader header{};
+    header.magic = NMappedMagic;
+    header.version = NMappedVersion;
+    header.layout = TLayout::NLayoutId;
+    header.key_size = sizeof(TKey);
+    header.value_size = sizeof(TValue);
+    header.data_size = sizeof(TData);
+    header.data_align = alignof(TData);
+
+    return header;
+}
+
+template<class TTable>
+SMappedHeader CMappedHashTable<TTable>::
+make_header(const TTable& table, size_t stash_count) noexcept
+{
+    SMappedHeader header = type_header();
+    header.size = table.size();
+    header.capacity = TLayout::capacity(table);
+    header.slot_count = TLayout::slot_count(table);
+    header.stash_count = stash_count;
+
+    header.state_offset = align_up(sizeof(SMappedHeader));
+    header.data_offset = align_up(header.state_offset +
+                                  header.slot_count * sizeof(TState));
+    header.stash_offset = align_up(header.data_offset +
+                                   header.slot_count * sizeof(TData));
+    header.file_size = header.stash_offset +
+                       header.stash_count * sizeof(TData);
+
+    return header;
+}
+
+template<class TTable>
+void CMappedHashTable<TTable>::
+save(TTable& table, const std::string& path)
+{
+    TLayout::prepare(table);
+
+    std::vector<const TData*> stash = TLayout::stash(table);
+    SMappedHeader header = make_header(table, stash.size());
+    const char padding[NMappedAlign] = {};
+    auto pad_to = [&padding](std::ofstream& stream, uint64_t offset) {
+            stream.write(padding, static_cast<std::streamsize>(
+                    offset - static_cast<uint64_t>(stream.tellp())));
+        };
+
+    std::string temp_path = path + ".tmp";
+    std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+        throw std::runtime_error(
+                "CMappedHashTable::save(): can not open " + temp_path);
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    pad_to(stream, header.state_offset);
+    for (size_t index = 0u; index < header.slot_count; ++index)
+    {
+        TState state = TLayout::state_at(table, index);
+        stream.write(reinterpret_cast<const char*>(&state), sizeof(state));
+    }
+
+    pad_to(stream, header.data_offset);
+    for (size_t index = 0u; index < header.slot_count; ++index)
+    {
+        // Zeroes keep whatever the memory held before out of the file
+        if (!TLayout::is_used(TLayout::state_at(table, index)))
+        {
+            for (size_t left = sizeof(TData); left > 0u; )
+            {
+                size_t chunk = std::min(left, NMappedAlign);
+                stream.write(padding, static_cast<std::streamsize>(chunk));
+                left -= chunk;
+            }
+
+            continue;
+        }
+
+        stream.write(
+                reinterpret_cast<const char*>(&TLayout::data_at(table, index)),
+                sizeof(TData));
+    }
+
+    pad_to(stream, header.stash_offset);
+    for (const TData* data : stash)
+        stream.write(reinterpret_cast<const char*>(data), sizeof(TData));
+
+    stream.close();
+    if (!stream)
+    {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error(
+                "CMappedHashTable::save(): can not write " + temp_path);
+    }
+
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error(
+                "CMappedHashTable::save(): can not rename " + temp_path +
+                " to " + path);
+    }
+}
+
+} // namespace
+
+#endif // MAPPED_HASHTABLE_H_
@@ -11,20 +11,31 @@
 namespace {
 
 template<class TK, class TV, 
-         class TBH = std::hash<TK>, class TIH = std::hash<TK>, size_t NLR = 4u>
-class COpenDoubleAddrHashTable final : public IOpenAddrHashTable<TK, TV>
+         class TBH = std::hash<TK>, class TIH = std::hash<TK>, size_t NLR = 4u,
+         class TC = CPow2Capacity, class TR = CFullRehash,
+         class TS = CNoShrink>
+class COpenDoubleAddrHashTable final :
+    public IOpenAddrHashTable<TK, TV, CDoubleProbe<TK, TBH, TIH>, NLR,
+                              TC, TR, TS>
 {
 public:
-    using typename IOpenAddrHashTable<TK, TV>::TKey;
-    using typename IOpenAddrHashTable<TK, TV>::TValue;
-    using typename IOpenAddrHashTable<TK, TV>::TData;
+    using TBase =
+        IOpenAddrHashTable<TK, TV, CDoubleProbe<TK, TBH, TIH>, NLR,
+                           TC, TR, TS>;
+
+    using typename TBase::TKey;
+    using typename TBase::TValue;
+    using typename TBase::TData;
                             
-    using IOpenAddrHashTable<TK, TV>::NStartCapacity;
-    using IOpenAddrHashTable<TK, TV>::NRehashFactor;
+    using TBase::NStartCapacity;
+    using TBase::NRehashFactor;
 
     using TBaseHasher = TBH;
     using TIterHasher = TIH;
-    static constexpr size_t NLoadRatio = NLR;
+    using typename TBase::TCapacity;
+    using typename TBase::TRehash;
+    using typename TBase::TShrink;
+    using TBase::NLoadRatio;
 
     COpenDoubleAddrHashTable() = default;
 
@@ -32,6 +43,8 @@ public:
     COpenDoubleAddrHashTable(TIter begin_it, TIter end_it):
         COpenDoubleAddrHashTable()
     {
+        this->reserve(range_size(begin_it, end_it));
+
         for (auto it = begin_it; it != end_it; ++it)
         {
             auto& [key, value] = *it;
@@ -39,72 +52,33 @@ public:
         }
     }
 
+    using TBase::insert;
+    using TBase::erase;
+    using TBase::find;
+
     virtual bool insert(const TKey& key, const TValue& value) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::insert(key, value);
+        return this->TBase::insert(key, value);
     }
 
     virtual bool erase(const TKey& desired) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::erase(desired);
+        return this->TBase::erase(desired);
     }
 
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<TValue>> 
         find(const TKey& desired) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::find(desired);
+        return this->TBase::find(desired);
     }
 
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<const TValue>> 
         find(const TKey& desired) const override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::find(desired);
+        return this->TBase::find(desired);
     }
-
-protected:
-    [[nodiscard]]
-    virtual size_t run(size_t index, size_t count) const noexcept override final
-    {
-        return (base_hash_vec_[index] + 
-                count * iter_hash_vec_[index]) % this->capacity();
-    }
-
-    [[nodiscard]]
-    virtual size_t pos(const TKey& desired) const noexcept override final
-    {
-        size_t base_hash = base_hasher_(desired);
-        // This transformation is used in order to make hash odd
-        size_t iter_hash = 2 * iter_hasher_(desired) + 1;
-
-        size_t index = base_hash % this->capacity();
-        base_hash_vec_[index] = base_hash;
-        iter_hash_vec_[index] = iter_hash;
-
-        return index;
-    }
-
-    [[nodiscard]]
-    virtual size_t get_load_ratio() const noexcept override final
-    {
-        return NLoadRatio;
-    }
-
-    virtual void rehash(size_t new_capacity) override final
-    {
-        base_hash_vec_.resize(new_capacity, 0u);
-        iter_hash_vec_.resize(new_capacity, 0u);
-        this->IOpenAddrHashTable<TK, TV>::rehash(new_capacity);
-    }
-
-private:
-    TBaseHasher base_hasher_{};
-    TIterHasher iter_hasher_{};
-    mutable std::vector<size_t> base_hash_vec_ = 
-        std::vector<size_t>(NStartCapacity, 0u);
-    mutable std::vector<size_t> iter_hash_vec_ = 
-        std::vector<size_t>(NStartCapacity, 0u);
 };
 
 } // namespace
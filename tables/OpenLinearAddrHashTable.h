@@ -7,22 +7,33 @@
 #include <optional>
 #include <functional>
 #include <stdexcept>
+#include <iterator>
+#include <type_traits>
 
 namespace {
 
-template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 4u>
-class COpenLinearAddrHashTable final : public IOpenAddrHashTable<TK, TV>
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 4u,
+         class TC = CPow2Capacity, class TR = CFullRehash,
+         class TS = CNoShrink>
+class COpenLinearAddrHashTable final :
+    public IOpenAddrHashTable<TK, TV, CLinearProbe<TK, TH>, NLR, TC, TR, TS>
 {
 public:
-    using typename IOpenAddrHashTable<TK, TV>::TKey;
-    using typename IOpenAddrHashTable<TK, TV>::TValue;
-    using typename IOpenAddrHashTable<TK, TV>::TData;
+    using TBase =
+        IOpenAddrHashTable<TK, TV, CLinearProbe<TK, TH>, NLR, TC, TR, TS>;
+
+    using typename TBase::TKey;
+    using typename TBase::TValue;
+    using typename TBase::TData;
                             
-    using IOpenAddrHashTable<TK, TV>::NStartCapacity;
-    using IOpenAddrHashTable<TK, TV>::NRehashFactor;
+    using TBase::NStartCapacity;
+    using TBase::NRehashFactor;
 
     using THasher = TH;
-    static constexpr size_t NLoadRatio = NLR;
+    using typename TBase::TCapacity;
+    using typename TBase::TRehash;
+    using typename TBase::TShrink;
+    using TBase::NLoadRatio;
 
     COpenLinearAddrHashTable() = default;
 
@@ -30,6 +41,8 @@ public:
     COpenLinearAddrHashTable(TIter begin_it, TIter end_it):
         COpenLinearAddrHashTable()
     {
+        this->reserve(range_size(begin_it, end_it));
+
         for (auto it = begin_it; it != end_it; ++it)
         {
             auto& [key, value] = *it;
@@ -37,63 +50,51 @@ public:
         }
     }
 
+    // Parallel bulk build for large key sets, see IOpenAddrHashTable::build().
+    // Linear probing keeps most probe sequences within the region of their
+    // first slot, so few keys are left for the serial pass.
+    template<typename TIter>
+    COpenLinearAddrHashTable(TIter begin_it, TIter end_it,
+                             size_t thread_count):
+        COpenLinearAddrHashTable()
+    {
+        static_assert(
+            std::is_base_of_v<
+                std::random_access_iterator_tag,
+                typename std::iterator_traits<TIter>::iterator_category>,
+            "bulk build requires random access iterators");
+
+        this->build(begin_it, static_cast<size_t>(end_it - begin_it),
+                    thread_count);
+    }
+
+    using TBase::insert;
+    using TBase::erase;
+    using TBase::find;
+
     virtual bool insert(const TKey& key, const TValue& value) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::insert(key, value);
+        return this->TBase::insert(key, value);
     }
 
     virtual bool erase(const TKey& desired) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::erase(desired);
+        return this->TBase::erase(desired);
     }
 
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<TValue>> 
         find(const TKey& desired) override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::find(desired);
+        return this->TBase::find(desired);
     }
 
     [[nodiscard]]
     virtual std::optional<std::reference_wrapper<const TValue>> 
         find(const TKey& desired) const override final
     {
-        return this->IOpenAddrHashTable<TK, TV>::find(desired);
-    }
-
-protected:
-    [[nodiscard]]
-    virtual size_t run(size_t index, size_t count) const noexcept override final
-    {
-        return (hash_vec_[index] + count) % this->capacity();
+        return this->TBase::find(desired);
     }
-
-    [[nodiscard]]
-    virtual size_t pos(const TKey& desired) const noexcept override final
-    {
-        size_t hash = hasher_(desired);
-        size_t index = hash % this->capacity();
-        hash_vec_[index] = hash;
-
-        return index;
-    }
-
-    [[nodiscard]]
-    virtual size_t get_load_ratio() const noexcept override final
-    {
-        return NLoadRatio;
-    }
-
-    virtual void rehash(size_t new_capacity) override final
-    {
-        hash_vec_.resize(new_capacity, 0u);
-        this->IOpenAddrHashTable<TK, TV>::rehash(new_capacity);
-    }
-
-private:
-    THasher hasher_{};
-    mutable std::vector<size_t> hash_vec_ = 
-        std::vector<size_t>(NStartCapacity, 0u);
 };
 
 } // namespace
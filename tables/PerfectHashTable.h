@@ -0,0 +1,527 @@
+#ifndef PERFECT_HASHTABLE_H_
+#define PERFECT_HASHTABLE_H_
+
+#include "IHashTable.h"
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+
+namespace {
+
+// Immutable table over a minimal perfect hash function built in PTHash
+// style. Keys are split into buckets of a few keys each, and every bucket
+// gets the smallest pilot that sends all its keys to free slots; buckets
+// are placed largest first while the table is still empty. Elements sit in
+// a dense array with no empty slots, so a lookup is one pilot read and one
+// key comparison.
+//
+// Slots are spread over size() / NLoadPercent% positions, which keeps
+// pilots small, and the few keys landing past size() are remapped to the
+// free slots below it. Pilots and remapped slots are bit packed to the
+// width of the largest one of each.
+// Keys the hasher can not tell apart, likely with 32-bit hashers on large
+// sets, are kept in a small sorted array searched on misses only.
+//
+// The table can not be updated, so it does not implement IHashTable.
+template<class TK, class TV, class TH = std::hash<TK>>
+class CPerfectHashTable final
+{
+public:
+    using TKey = const std::remove_cv_t<std::remove_reference_t<TK>>;
+    using TValue = TV;
+    using TData = std::pair<TKey, TValue>;
+    using TRawKey = std::remove_cv_t<std::remove_reference_t<TK>>;
+    using THasher = TH;
+
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+
+    // Keys per position, in percent
+    static constexpr size_t NLoadPercent = 98u;
+    // Buckets per key times log2 of the key count
+    static constexpr size_t NBucketFactor = 5u;
+    // Share of keys sent to the dense buckets and share of those buckets,
+    // in percent
+    static constexpr size_t NDenseKeyPercent = 60u;
+    static constexpr size_t NDenseBucketPercent = 30u;
+
+    // Pilot search gives up past NMaxPilot and retries with another seed
+    static constexpr uint64_t NMaxPilot = uint64_t{ 1u } << 20u;
+    static constexpr size_t NMaxAttempts = 16u;
+
+    CPerfectHashTable() = default;
+
+    // Later elements with equal keys replace earlier ones, as with inserts
+    template<typename TIter>
+    CPerfectHashTable(TIter begin_it, TIter end_it)
+    {
+        std::vector<std::pair<TRawKey, TValue>> element_vec;
+        element_vec.reserve(range_size(begin_it, end_it));
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            element_vec.emplace_back(key, value);
+        }
+
+        for (size_t attempt = 0u; attempt < NMaxAttempts; ++attempt)
+        {
+            seed_ = mix(attempt + 1u);
+            if (build(element_vec))
+                return;
+        }
+
+        throw std::invalid_argument(
+                "CPerfectHashTable::CPerfectHashTable(): "
+                "no pilot found for some bucket"
+                );
+    }
+
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        return data_vec_.size() + collision_vec_.size();
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept
+    {
+        return size();
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return data_vec_.empty();
+    }
+
+    // Values may be changed in place, keys may not
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>> find(const TKey& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const
+    {
+        return find_core(desired);
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    // Element of the key set, ordered by bucket while it is built
+    struct SEntry
+    {
+        uint64_t hash;
+        size_t index;
+    };
+
+    [[nodiscard]]
+    static inline uint64_t mix(uint64_t hash) noexcept
+    {
+        hash ^= hash >> 33u;
+        hash *= 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 33u;
+        hash *= 0xC4CEB9FE1A85EC53u;
+        hash ^= hash >> 33u;
+
+        return hash;
+    }
+
+    // Maps `value` onto [0, range) by the high bits of the product
+    [[nodiscard]]
+    static inline size_t reduce(uint64_t value, size_t range) noexcept
+    {
+        __extension__ using TWide = unsigned __int128;
+
+        return static_cast<size_t>(
+                (static_cast<TWide>(value) * range) >> 64u);
+    }
+
+    // Hashers like std::hash may be identity, so the hash is mixed
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline uint64_t hash_of(const TKeyLike& desired) const noexcept
+    {
+        return mix(static_cast<uint64_t>(hasher_(desired)) ^ seed_);
+    }
+
+    // High bits pick the dense or the sparse buckets, low bits the bucket
+    [[nodiscard]]
+    inline size_t bucket_of(uint64_t hash) const noexcept
+    {
+        constexpr uint64_t NDenseLimit =
+            (uint64_t{ 1u } << 32u) / 100u * NDenseKeyPercent;
+
+        uint64_t low = hash & 0xFFFFFFFFu;
+        if ((hash >> 32u) < NDenseLimit)
+            return static_cast<size_t>((low * dense_count_) >> 32u);
+
+        return dense_count_ + static_cast<size_t>(
+                (low * (bucket_count_ - dense_count_)) >> 32u);
+    }
+
+    // Keys of a bucket differ in the high bits of the hash, and the high
+    // bits of the product depend on all of them
+    [[nodiscard]]
+    inline size_t position_of(uint64_t hash,
+                              uint64_t pilot_hash) const noexcept
+    {
+        return reduce((hash ^ pilot_hash) * 0x9E3779B97F4A7C15u,
+                      position_count_);
+    }
+
+    [[nodiscard]]
+    inline uint64_t pilot_hash_of(uint64_t pilot) const noexcept
+    {
+        return mix(pilot ^ seed_);
+    }
+
+    // Least width of `max_value`, at least one bit. Pilots and slots stay
+    // far below 2^63, so a field never takes a whole word.
+    [[nodiscard]]
+    static inline size_t bits_of(uint64_t max_value) noexcept
+    {
+        size_t bits = 1u;
+        while ((max_value >> bits) != 0u)
+            ++bits;
+
+        return bits;
+    }
+
+    // Packs `value_vec` into words of `bits` wide fields, with one word of
+    // padding so that reads never check for the end
+    [[nodiscard]]
+    static std::vector<uint64_t> pack(const std::vector<uint64_t>& value_vec,
+                                      size_t bits)
+    {
+        std::vector<uint64_t> result(
+                (value_vec.size() * bits + 63u) / 64u + 1u, 0u);
+        for (size_t index = 0u; index < value_vec.size(); ++index)
+        {
+            size_t bit = index * bits;
+            size_t shift = bit % 64u;
+
+            result[bit / 64u] |= value_vec[index] << shift;
+            if (shift + bits > 64u)
+                result[bit / 64u + 1u] |= value_vec[index] >> (64u - shift);
+        }
+
+        return result;
+    }
+
+    [[nodiscard]]
+    static inline uint64_t packed_at(const std::vector<uint64_t>& word_vec,
+                                     size_t index, size_t bits) noexcept
+    {
+        size_t bit = index * bits;
+        size_t word = bit / 64u;
+        size_t shift = bit % 64u;
+
+        uint64_t result = word_vec[word] >> shift;
+        if (shift + bits > 64u)
+            result |= word_vec[word + 1u] << (64u - shift);
+
+        return result & ((uint64_t{ 1u } << bits) - 1u);
+    }
+
+    [[nodiscard]]
+    inline size_t slot_of(uint64_t hash) const noexcept
+    {
+        uint64_t pilot = packed_at(pilot_vec_, bucket_of(hash), pilot_bits_);
+        size_t position = position_of(hash, pilot_hash_of(pilot));
+        if (position < data_vec_.size())
+            return position;
+
+        return static_cast<size_t>(packed_at(
+                    remap_vec_, position - data_vec_.size(), remap_bits_));
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (data_vec_.empty())
+            return std::nullopt;
+
+        uint64_t hash = hash_of(desired);
+        if (auto& [key, value] = data_vec_[slot_of(hash)]; key == desired)
+            return std::cref(value);
+
+        if (collision_vec_.empty())
+            return std::nullopt;
+
+        for (size_t index = static_cast<size_t>(
+                 std::lower_bound(collision_hash_vec_.begin(),
+                                  collision_hash_vec_.end(), hash) -
+                 collision_hash_vec_.begin());
+             index < collision_vec_.size() &&
+             collision_hash_vec_[index] == hash; ++index)
+        {
+            if (auto& [key, value] = collision_vec_[index]; key == desired)
+                return std::cref(value);
+        }
+
+        return std::nullopt;
+    }
+
+    // Builds the function for the current seed and moves the elements into
+    // place. Returns false with `element_vec` untouched if some bucket
+    // found no pilot.
+    bool build(std::vector<std::pair<TRawKey, TValue>>& element_vec);
+
+private:
+    uint64_t seed_{};
+    THasher hasher_{};
+
+    size_t position_count_{};
+    size_t bucket_count_{};
+    size_t dense_count_{};
+
+    size_t pilot_bits_{};
+    std::vector<uint64_t> pilot_vec_{};
+    // Slot of every position past size(), indexed from size()
+    size_t remap_bits_{};
+    std::vector<uint64_t> remap_vec_{};
+
+    std::vector<TData> data_vec_{};
+
+    // Keys sharing the hash of a key in `data_vec_`, sorted by hash
+    std::vector<uint64_t> collision_hash_vec_{};
+    std::vector<TData> collision_vec_{};
+};
+
+template<class TK, class TV, class TH>
+bool CPerfectHashTable<TK, TV, TH>::
+build(std::vector<std::pair<TRawKey, TValue>>& element_vec)
+{
+    std::vector<SEntry> entry_vec(element_vec.size());
+    for (size_t index = 0u; index < element_vec.size(); ++index)
+        entry_vec[index] = SEntry{ hash_of(element_vec[index].first), index };
+
+    // Equal keys end up next to each other with the last one kept
+    std::sort(entry_vec.begin(), entry_vec.end(),
+              [](const SEntry& lhs, const SEntry& rhs) {
+                  return (lhs.hash != rhs.hash ?
+                          lhs.hash < rhs.hash : lhs.index > rhs.index);
+              });
+
+    // No pilot tells apart keys the hasher maps to the same value, so all
+    // but the first of them are set aside. Runs of a hash are short.
+    std::vector<SEntry> collision_entry_vec;
+    size_t count = 0u;
+    for (size_t begin = 0u, end = 0u; begin < entry_vec.size(); begin = end)
+    {
+        while (end < entry_vec.size() &&
+               entry_vec[end].hash == entry_vec[begin].hash)
+            ++end;
+
+        SEntry first = entry_vec[begin];
+        size_t run_begin = collision_entry_vec.size();
+        for (size_t index = begin + 1u; index < end; ++index)
+        {
+            const auto& key = element_vec[entry_vec[index].index].first;
+
+            bool seen = (element_vec[first.index].first == key);
+            for (size_t kept = run_begin;
+                 !seen && kept < collision_entry_vec.size(); ++kept)
+                seen = (element_vec[collision_entry_vec[kept].index].first ==
+                        key);
+
+            if (!seen)
+                collision_entry_vec.push_back(entry_vec[index]);
+        }
+
+        entry_vec[count++] = first;
+    }
+
+    entry_vec.resize(count);
+
+    size_t log_count = 1u;
+    while ((size_t{ 1u } << log_count) <= count)
+        ++log_count;
+
+    position_count_ = std::max<size_t>(
+            (count * 100u + NLoadPercent - 1u) / NLoadPercent, 1u);
+    bucket_count_ = std::max<size_t>(
+            (count * NBucketFactor + log_count - 1u) / log_count, 2u);
+    dense_count_ = std::max<size_t>(
+            bucket_count_ * NDenseBucketPercent / 100u, 1u);
+
+    // Counting sort of the keys by bucket, then of the buckets by size
+    std::vector<size_t> bucket_begin_vec(bucket_count_ + 1u, 0u);
+    for (const SEntry& entry : entry_vec)
+        ++bucket_begin_vec[bucket_of(entry.hash) + 1u];
+
+    size_t max_bucket_size = 0u;
+    for (size_t bucket = 0u; bucket < bucket_count_; ++bucket)
+    {
+        max_bucket_size =
+            std::max(max_bucket_size, bucket_begin_vec[bucket + 1u]);
+        bucket_begin_vec[bucket + 1u] += bucket_begin_vec[bucket];
+    }
+
+    std::vector<SEntry> bucket_entry_vec(count);
+    {
+        std::vector<size_t> fill_vec(bucket_begin_vec.begin(),
+                                     bucket_begin_vec.end() - 1);
+        for (const SEntry& entry : entry_vec)
+            bucket_entry_vec[fill_vec[bucket_of(entry.hash)]++] = entry;
+    }
+
+    std::vector<size_t> size_begin_vec(max_bucket_size + 2u, 0u);
+    for (size_t bucket = 0u; bucket < bucket_count_; ++bucket)
+    {
+        size_t bucket_size =
+            bucket_begin_vec[bucket + 1u] - bucket_begin_vec[bucket];
+        ++size_begin_vec[max_bucket_size - bucket_size + 1u];
+    }
+
+    for (size_t index = 1u; index < size_begin_vec.size(); ++index)
+        size_begin_vec[index] += size_begin_vec[index - 1u];
+
+    std::vector<size_t> order_vec(bucket_count_);
+    for (size_t bucket = 0u; bucket < bucket_count_; ++bucket)
+    {
+        size_t bucket_size =
+            bucket_begin_vec[bucket + 1u] - bucket_begin_vec[bucket];
+        order_vec[size_begin_vec[max_bucket_size - bucket_size]++] = bucket;
+    }
+
+    // Pilot search, largest buckets first
+    std::vector<bool> taken_vec(position_count_, false);
+    std::vector<uint64_t> pilot_of_vec(bucket_count_, 0u);
+    std::vector<size_t> position_vec;
+    uint64_t max_pilot = 0u;
+
+    for (size_t bucket : order_vec)
+    {
+        size_t begin = bucket_begin_vec[bucket];
+        size_t end = bucket_begin_vec[bucket + 1u];
+        if (begin == end)
+            break;
+
+        for (uint64_t pilot = 0u; ; ++pilot)
+        {
+            if (pilot > NMaxPilot)
+                return false;
+
+            uint64_t pilot_hash = pilot_hash_of(pilot);
+
+            position_vec.clear();
+            for (size_t index = begin; index < end; ++index)
+            {
+                size_t position =
+                    position_of(bucket_entry_vec[index].hash, pilot_hash);
+                if (taken_vec[position] ||
+                    std::find(position_vec.begin(), position_vec.end(),
+                              position) != position_vec.end())
+                    break;
+
+                position_vec.push_back(position);
+            }
+
+            if (position_vec.size() == end - begin)
+            {
+                for (size_t position : position_vec)
+                    taken_vec[position] = true;
+
+                pilot_of_vec[bucket] = pilot;
+                max_pilot = std::max(max_pilot, pilot);
+                break;
+            }
+        }
+    }
+
+    pilot_bits_ = bits_of(max_pilot);
+    pilot_vec_ = pack(pilot_of_vec, pilot_bits_);
+
+    // Taken positions past `count` are as many as free ones below it
+    std::vector<uint64_t> remap_of_vec(position_count_ - count, 0u);
+    uint64_t max_remap = 0u;
+    for (size_t free = 0u, position = count;
+         position < position_count_; ++position)
+    {
+        if (!taken_vec[position])
+            continue;
+
+        while (taken_vec[free])
+            ++free;
+
+        remap_of_vec[position - count] = free;
+        max_remap = std::max<uint64_t>(max_remap, free++);
+    }
+
+    remap_bits_ = bits_of(max_remap);
+    remap_vec_ = pack(remap_of_vec, remap_bits_);
+
+    // Elements are moved in slot order, so the array is built in one pass
+    std::vector<size_t> index_of_vec(count);
+    data_vec_.clear();
+    for (const SEntry& entry : entry_vec)
+    {
+        size_t position = position_of(
+                entry.hash, pilot_hash_of(pilot_of_vec[bucket_of(entry.hash)]));
+        size_t slot = (position < count ?
+                       position :
+                       static_cast<size_t>(remap_of_vec[position - count]));
+        index_of_vec[slot] = entry.index;
+    }
+
+    data_vec_.reserve(count);
+    for (size_t slot = 0u; slot < count; ++slot)
+        data_vec_.emplace_back(std::move(element_vec[index_of_vec[slot]]));
+
+    collision_hash_vec_.clear();
+    collision_vec_.clear();
+    collision_vec_.reserve(collision_entry_vec.size());
+    for (const SEntry& entry : collision_entry_vec)
+    {
+        collision_hash_vec_.push_back(entry.hash);
+        collision_vec_.emplace_back(std::move(element_vec[entry.index]));
+    }
+
+    return true;
+}
+
+} // namespace
+
+#endif // PERFECT_HASHTABLE_H_
@@ -0,0 +1,126 @@
+#ifndef PROBE_POLICY_H_
+#define PROBE_POLICY_H_
+
+#include "IHashTable.h"
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+namespace {
+
+// Probe policies hash the key once per operation into SProbe and then give
+// the position of every step of its probe sequence before reduction to
+// the table capacity. Any type the hashers accept may stand for the key.
+// NNeedsPowerOfTwo tells that the sequence visits every slot only of
+// a power of 2 capacity.
+
+template<class TK, class TH = std::hash<TK>>
+class CLinearProbe
+{
+public:
+    using TKey = const std::remove_cv_t<std::remove_reference_t<TK>>;
+    using THasher = TH;
+
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+    static constexpr bool NNeedsPowerOfTwo = false;
+
+    struct SProbe
+    {
+        size_t hash;
+    };
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline SProbe pos(const TKeyLike& desired) const noexcept
+    {
+        return SProbe{ hasher_(desired) };
+    }
+
+    [[nodiscard]]
+    static inline size_t run(const SProbe& probe, size_t count) noexcept
+    {
+        return probe.hash + count;
+    }
+
+private:
+    THasher hasher_{};
+};
+
+template<class TK, class TH = std::hash<TK>>
+class CQuadroProbe
+{
+public:
+    using TKey = const std::remove_cv_t<std::remove_reference_t<TK>>;
+    using THasher = TH;
+
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+    static constexpr bool NNeedsPowerOfTwo = true;
+
+    struct SProbe
+    {
+        size_t hash;
+    };
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline SProbe pos(const TKeyLike& desired) const noexcept
+    {
+        return SProbe{ hasher_(desired) };
+    }
+
+    // Triangular numbers visit every slot of a power of 2 capacity only,
+    // so tables with this probe require CPow2Capacity
+    [[nodiscard]]
+    static inline size_t run(const SProbe& probe, size_t count) noexcept
+    {
+        return probe.hash + count * (count + 1u) / 2u;
+    }
+
+private:
+    THasher hasher_{};
+};
+
+template<class TK, class TBH = std::hash<TK>, class TIH = std::hash<TK>>
+class CDoubleProbe
+{
+public:
+    using TKey = const std::remove_cv_t<std::remove_reference_t<TK>>;
+    using TBaseHasher = TBH;
+    using TIterHasher = TIH;
+
+    static constexpr bool NIsTransparent =
+        SIsTransparent<TBaseHasher>::value &&
+        SIsTransparent<TIterHasher>::value;
+    static constexpr bool NNeedsPowerOfTwo = true;
+
+    struct SProbe
+    {
+        size_t hash;
+        size_t step;
+    };
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    inline SProbe pos(const TKeyLike& desired) const noexcept
+    {
+        // This transformation is used in order to make hash odd
+        return SProbe{ base_hasher_(desired), 2 * iter_hasher_(desired) + 1 };
+    }
+
+    // Odd step is coprime with power of 2 capacity, so no slot is missed;
+    // any other capacity may share a factor with it, see CPow2Capacity
+    [[nodiscard]]
+    static inline size_t run(const SProbe& probe, size_t count) noexcept
+    {
+        return probe.hash + count * probe.step;
+    }
+
+private:
+    TBaseHasher base_hasher_{};
+    TIterHasher iter_hasher_{};
+};
+
+} // namespace
+
+#endif // PROBE_POLICY_H_
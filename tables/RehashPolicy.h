@@ -0,0 +1,31 @@
+#ifndef REHASH_POLICY_H_
+#define REHASH_POLICY_H_
+
+#include <cstddef>
+
+namespace {
+
+// Rehash policies tell how many old slots or buckets every operation moves
+// to the new storage after the table has grown. Zero means that rehash
+// moves everything at once.
+
+class CFullRehash
+{
+public:
+    static constexpr size_t NMigrateStep = 0u;
+};
+
+// Old and new storage coexist until the old one is drained, so no single
+// operation pays for the whole table
+template<size_t NMS = 8u>
+class CIncrementalRehash
+{
+public:
+    static_assert(NMS > 0u, "migrate step must be positive");
+
+    static constexpr size_t NMigrateStep = NMS;
+};
+
+} // namespace
+
+#endif // REHASH_POLICY_H_
@@ -0,0 +1,416 @@
+#ifndef ROBIN_HOOD_HASHTABLE_H_
+#define ROBIN_HOOD_HASHTABLE_H_
+
+#include "IHashTable.h"
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
+
+namespace {
+
+// Linear probing that keeps every cluster sorted by home slot, so a lookup
+// stops as soon as it meets a key closer to its home than the desired one
+// would be. Erase shifts the rest of the cluster back, leaving no tombstones.
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 4u,
+         class TC = CPow2Capacity>
+class CRobinHoodHashTable final : public IHashTable<TK, TV>
+{
+public:
+    using typename IHashTable<TK, TV>::TKey;
+    using typename IHashTable<TK, TV>::TValue;
+    using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
+    using THasher = TH;
+    using TCapacity = TC;
+
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    // Probe distance plus one, zero marks an empty slot
+    using TDist = uint32_t;
+
+    static constexpr size_t NStartCapacity = 1u;
+    static constexpr size_t NLoadRatio = NLR;
+    static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+
+    static constexpr TDist NDistEmpty = 0u;
+
+    CRobinHoodHashTable() = default;
+
+    template<typename TIter>
+    CRobinHoodHashTable(TIter begin_it, TIter end_it):
+        CRobinHoodHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CRobinHoodHashTable(const CRobinHoodHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        hasher_(other.hasher_),
+        dist_vec_(other.dist_vec_.size(), NDistEmpty),
+        data_vec_(other.data_vec_.size())
+    {
+        for (size_t index = 0u; index < dist_vec_.size(); ++index)
+        {
+            if (other.dist_vec_[index] != NDistEmpty)
+                construct_at(index, other.get_data_at(index));
+
+            dist_vec_[index] = other.dist_vec_[index];
+        }
+    }
+
+    CRobinHoodHashTable& operator = (const CRobinHoodHashTable& other)
+    {
+        if (this != &other)
+        {
+            CRobinHoodHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CRobinHoodHashTable(CRobinHoodHashTable&& other) noexcept:
+        CRobinHoodHashTable()
+    {
+        swap(other);
+    }
+
+    CRobinHoodHashTable& operator = (CRobinHoodHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CRobinHoodHashTable() final
+    {
+        for (size_t index = 0u; index < dist_vec_.size(); ++index)
+        {
+            if (dist_vec_[index] != NDistEmpty)
+                destruct_at(index);
+        }
+    }
+
+    void swap(CRobinHoodHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(hasher_, other.hasher_);
+        std::swap(dist_vec_, other.dist_vec_);
+        std::swap(data_vec_, other.data_vec_);
+    }
+
+    [[nodiscard]]
+    virtual size_t size() const noexcept override final
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    virtual size_t capacity() const noexcept override final
+    {
+        return data_vec_.size();
+    }
+
+    [[nodiscard]]
+    virtual bool empty() const noexcept override final
+    {
+        return size_ == 0u;
+    }
+
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = TCapacity::round(
+                capacity_for(count, NLoadRatio));
+        if (new_capacity > capacity())
+            rehash(new_capacity);
+    }
+
+    virtual bool insert(const TKey& desired,
+                        const TValue& desired_value) override final
+    {
+        return emplace_core<true>(desired, desired_value);
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>>
+        find(const TKey& desired) override final
+    {
+        auto result =
+            const_cast<const CRobinHoodHashTable&>(*this).find(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const override final
+    {
+        return find_core(desired);
+    }
+
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    using IHashTable<TK, TV>::capacity_for;
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        if (capacity() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio)
+            rehash(capacity() * NRehashFactor);
+
+        auto [offset, dist] = search(desired, hasher_(desired));
+        if (dist_vec_[offset] == dist)
+        {
+            if constexpr (NAssign)
+                get_data_at(offset).second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        place(offset, dist, std::piecewise_construct,
+              std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+              std::forward_as_tuple(std::forward<Types>(args)...));
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        auto [offset, dist] = search(desired, hasher_(desired));
+        if (dist_vec_[offset] != dist)
+            return false;
+
+        destruct_at(offset);
+        --size_;
+
+        // Backward shift: every following key not at its home moves one
+        // slot closer to it
+        for (size_t next = TCapacity::index(offset + 1u, capacity());
+             dist_vec_[next] > 1u;
+             offset = next, next = TCapacity::index(next + 1u, capacity()))
+        {
+            construct_at(offset, std::move(get_data_at(next)));
+            dist_vec_[offset] = dist_vec_[next] - 1u;
+            destruct_at(next);
+        }
+
+        dist_vec_[offset] = NDistEmpty;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (auto [offset, dist] = search(desired, hasher_(desired));
+            dist_vec_[offset] == dist)
+        {
+            auto& [key, value] = get_data_at(offset);
+            return std::make_optional(std::cref(value));
+        }
+
+        return std::nullopt;
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(size_t idx, Types&&... args)
+    {
+        return new (&data_vec_[idx]) TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(size_t idx)
+    {
+        std::launder(reinterpret_cast<TData*>(&data_vec_[idx]))->~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(size_t idx) const noexcept
+    {
+        return const_cast<CRobinHoodHashTable*>(this)->get_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&data_vec_[idx]));
+    }
+
+    // Returns the slot holding `desired` together with its distance if the
+    // key is present, otherwise the slot it should be placed in
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::pair<size_t, TDist> search(const TKeyLike& desired,
+                                    size_t hash) const noexcept
+    {
+        size_t offset = TCapacity::index(hash, capacity());
+        TDist dist = 1u;
+        for (; dist_vec_[offset] >= dist;
+             ++dist, offset = TCapacity::index(hash + dist - 1u, capacity()))
+        {
+            if (dist_vec_[offset] == dist &&
+                get_data_at(offset).first == desired)
+                break;
+        }
+
+        return { offset, dist };
+    }
+
+    // Shifts the cluster tail starting at `offset` one slot forward and puts
+    // the new element in its place, which keeps the cluster sorted
+    template<typename... Types>
+    void place(size_t offset, TDist dist, Types&&... args)
+    {
+        size_t last = offset;
+        while (dist_vec_[last] != NDistEmpty)
+            last = TCapacity::index(last + 1u, capacity());
+
+        for (size_t prev = 0u; last != offset; last = prev)
+        {
+            prev = TCapacity::index(last + capacity() - 1u, capacity());
+
+            construct_at(last, std::move(get_data_at(prev)));
+            dist_vec_[last] = dist_vec_[prev] + 1u;
+            destruct_at(prev);
+        }
+
+        construct_at(offset, std::forward<Types>(args)...);
+        dist_vec_[offset] = dist;
+    }
+
+    void rehash(size_t new_capacity)
+    {
+        if (new_capacity <= capacity())
+            throw std::invalid_argument(
+                    "CRobinHoodHashTable::rehash(): "
+                    "new_capacity <= capacity()"
+                    );
+
+        auto old_dist_vec = std::vector<TDist>(new_capacity, NDistEmpty);
+        auto old_data_vec = std::vector<TStorage>(new_capacity);
+
+        std::swap(dist_vec_, old_dist_vec);
+        std::swap(data_vec_, old_data_vec);
+
+        for (size_t index = 0u; index < old_data_vec.size(); ++index)
+        {
+            if (old_dist_vec[index] != NDistEmpty)
+            {
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                auto& [key, value] = *ptr;
+                auto [offset, dist] = search(key, hasher_(key));
+                place(offset, dist, key, std::move(value));
+
+                ptr->~TData();
+            }
+        }
+    }
+
+private:
+    size_t size_{};
+    THasher hasher_{};
+
+    std::vector<TDist> dist_vec_ =
+        std::vector<TDist>(NStartCapacity, NDistEmpty);
+    std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+};
+
+} // namespace
+
+#endif // ROBIN_HOOD_HASHTABLE_H_
@@ -0,0 +1,181 @@
+#ifndef SHARDED_HASHTABLE_H_
+#define SHARDED_HASHTABLE_H_
+
+#include "IHashTable.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+
+namespace {
+
+// Thread-safe wrapper over NShards independent tables of type TTable, each
+// one guarded by its own reader-writer lock. Keys are routed by the high
+// bits of a multiplicative hash, so the low bits the tables index with stay
+// independent of the shard. Rehash of a shard blocks only that shard.
+//
+// Lookups of a shard run at the same time under its shared lock, so TH and
+// the hashers of TTable must be safe to call from several threads at once,
+// as std::hash and the hashers of this repo are.
+//
+// As values may change concurrently find() returns a copy, so the wrapper
+// does not implement IHashTable.
+template<class TTable, size_t NShards = 64u,
+         class TH = std::hash<std::remove_cv_t<typename TTable::TKey>>>
+class CShardedHashTable final
+{
+public:
+    using TTableType = TTable;
+    using TKey = typename TTable::TKey;
+    using TValue = typename TTable::TValue;
+    using THasher = TH;
+
+    static_assert(NShards > 0u && (NShards & (NShards - 1u)) == 0u,
+                  "shard count must be a power of 2");
+
+    CShardedHashTable() = default;
+
+    template<typename TIter>
+    CShardedHashTable(TIter begin_it, TIter end_it):
+        CShardedHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CShardedHashTable(const CShardedHashTable&) = delete;
+    CShardedHashTable& operator = (const CShardedHashTable&) = delete;
+
+    // Takes the shard locks one by one, so the result is not a snapshot
+    // while writers are running
+    [[nodiscard]]
+    size_t size() const
+    {
+        size_t result = 0u;
+        for (const SShard& shard : shard_vec_)
+        {
+            std::shared_lock lock(shard.mutex);
+            result += shard.table.size();
+        }
+
+        return result;
+    }
+
+    [[nodiscard]]
+    size_t capacity() const
+    {
+        size_t result = 0u;
+        for (const SShard& shard : shard_vec_)
+        {
+            std::shared_lock lock(shard.mutex);
+            result += shard.table.capacity();
+        }
+
+        return result;
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return size() == 0u;
+    }
+
+    // Every shard gets an equal share, as keys spread over them evenly
+    void reserve(size_t count)
+    {
+        for (SShard& shard : shard_vec_)
+        {
+            std::unique_lock lock(shard.mutex);
+            shard.table.reserve((count + NShards - 1u) / NShards);
+        }
+    }
+
+    // Inserts or assigns, returns true if the key was not present
+    bool insert(const TKey& desired, const TValue& desired_value)
+    {
+        SShard& shard = shard_of(desired);
+        std::unique_lock lock(shard.mutex);
+
+        return shard.table.insert(desired, desired_value);
+    }
+
+    bool erase(const TKey& desired)
+    {
+        SShard& shard = shard_of(desired);
+        std::unique_lock lock(shard.mutex);
+
+        return shard.table.erase(desired);
+    }
+
+    [[nodiscard]]
+    std::optional<TValue> find(const TKey& desired) const
+    {
+        const SShard& shard = shard_of(desired);
+        std::shared_lock lock(shard.mutex);
+
+        if (auto result = shard.table.find(desired))
+            return result.value().get();
+
+        return std::nullopt;
+    }
+
+protected:
+    // Each shard starts on its own cache line, so locks of neighbouring
+    // shards do not false share
+    struct alignas(64) SShard
+    {
+        mutable std::shared_mutex mutex;
+        TTable table;
+    };
+
+    [[nodiscard]]
+    inline size_t shard_index(const TKey& desired) const noexcept
+    {
+        if constexpr (NShards == 1u)
+            return 0u;
+        else
+        {
+            uint64_t hash = static_cast<uint64_t>(hasher_(desired));
+            return static_cast<size_t>(
+                    (hash * 0x9E3779B97F4A7C15u) >> (64u - NShardBits));
+        }
+    }
+
+    [[nodiscard]]
+    inline SShard& shard_of(const TKey& desired) noexcept
+    {
+        return shard_vec_[shard_index(desired)];
+    }
+
+    [[nodiscard]]
+    inline const SShard& shard_of(const TKey& desired) const noexcept
+    {
+        return shard_vec_[shard_index(desired)];
+    }
+
+private:
+    static constexpr size_t NShardBits = []() {
+            size_t bits = 0u;
+            while ((size_t{ 1u } << bits) < NShards)
+                ++bits;
+
+            return bits;
+        }();
+
+    THasher hasher_{};
+
+    std::vector<SShard> shard_vec_ = std::vector<SShard>(NShards);
+};
+
+} // namespace
+
+#endif // SHARDED_HASHTABLE_H_
@@ -0,0 +1,531 @@
+#ifndef SHARED_MEM_HASHTABLE_H_
+#define SHARED_MEM_HASHTABLE_H_
+
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Linear probing table in a POSIX shared memory segment, written by one
+// thread of one process and read by any number of processes. Slots are
+// found by offsets from the segment start stored in its header, so every
+// process may map the segment at its own address.
+//
+// Readers take no locks and never write to the segment. Every slot has
+// a seqlock: the writer makes its sequence odd while changing the slot,
+// and a reader copies the slot and retries if the sequence was odd or
+// changed meanwhile. Erase leaves a tombstone, so elements never move
+// and a probe sequence never breaks while the writer works. Only when
+// tombstones use up the free slots the writer rebuilds the table in
+// place, under the table sequence all readers check around a lookup.
+//
+// Capacity is fixed at creation. As values may change concurrently
+// find() returns a copy, so the table does not implement IHashTable.
+template<class TK, class TV, class TH = std::hash<TK>>
+class CSharedMemHashTable final
+{
+public:
+    using TKey = TK;
+    using TValue = TV;
+    using THasher = TH;
+
+    static_assert(std::is_trivially_copyable_v<TKey> &&
+                  std::is_trivially_copyable_v<TValue>,
+                  "key and value must be trivially copyable");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+                  "atomics in shared memory must be lock-free");
+
+    // Slots used by elements and tombstones stay below 75% of capacity
+    static constexpr size_t NLoadRatio = 4u;
+
+    static constexpr uint32_t NStateEmpty = 0u;
+    static constexpr uint32_t NStateSkip = 1u;
+    static constexpr uint32_t NStateUsed = 2u;
+
+    // "SHMTABL1" read as a little endian integer
+    static constexpr uint64_t NMagic = 0x314C4241544D4853u;
+    static constexpr uint32_t NVersion = 1u;
+
+    // Creates segment `name` for up to `count` elements and opens it for
+    // writing. Fails if the segment already exists, see unlink().
+    CSharedMemHashTable(const std::string& name, size_t count);
+
+    // Opens existing segment `name` for reading
+    explicit CSharedMemHashTable(const std::string& name);
+
+    CSharedMemHashTable(const CSharedMemHashTable&) = delete;
+    CSharedMemHashTable& operator = (const CSharedMemHashTable&) = delete;
+
+    CSharedMemHashTable(CSharedMemHashTable&& other) noexcept
+    {
+        swap(other);
+    }
+
+    CSharedMemHashTable& operator = (CSharedMemHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    // The segment outlives the process, readers may still map it
+    ~CSharedMemHashTable()
+    {
+        if (base_ != nullptr)
+            munmap(base_, length_);
+    }
+
+    // Removes segment `name`, processes mapping it keep their mapping
+    static void unlink(const std::string& name) noexcept
+    {
+        shm_unlink(name.c_str());
+    }
+
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        return header_->size.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept
+    {
+        return header_->mask + 1u;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept
+    {
+        return size() == 0u;
+    }
+
+    [[nodiscard]]
+    bool writable() const noexcept
+    {
+        return writable_;
+    }
+
+    // Inserts or assigns, returns true if the key was not present
+    bool insert(const TKey& desired, const TValue& desired_value);
+
+    bool erase(const TKey& desired);
+
+    [[nodiscard]]
+    std::optional<TValue> find(const TKey& desired) const;
+
+protected:
+    struct SHeader
+    {
+        // Stored last by the creator, so a set magic means a ready table
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint32_t slot_size;
+        uint64_t mask;
+        uint64_t slot_offset;
+        uint64_t length;
+
+        // Odd while the writer rebuilds the table
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> size;
+        // Slots with elements or tombstones, kept by the writer only
+        uint64_t used;
+    };
+
+    struct SSlot
+    {
+        // Odd while the writer changes the slot
+        std::atomic<uint32_t> sequence;
+        uint32_t state;
+        TKey key;
+        TValue value;
+    };
+
+    // Consistent copy of a slot
+    struct SSlotView
+    {
+        uint32_t state;
+        TKey key;
+        TValue value;
+    };
+
+    static constexpr size_t NSlotOffset = (sizeof(SHeader) + 63u) / 64u * 64u;
+
+    [[nodiscard]]
+    inline size_t home_of(const TKey& desired) const noexcept
+    {
+        // Hashers like std::hash may be identity, so the hash is mixed to
+        // spread sequential keys over the table
+        uint64_t hash = static_cast<uint64_t>(hasher_(desired));
+        hash ^= hash >> 33u;
+        hash *= 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 33u;
+
+        return static_cast<size_t>(hash & header_->mask);
+    }
+
+    [[nodiscard]]
+    inline SSlot& slot_at(size_t index) const noexcept
+    {
+        return slots_[index];
+    }
+
+    // Data is copied with memcpy between the sequence loads, the fence
+    // keeps the copy before the second load
+    [[nodiscard]]
+    SSlotView read_slot(size_t index) const noexcept
+    {
+        const SSlot& slot = slot_at(index);
+        for (;;)
+        {
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if ((sequence & 1u) != 0u)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            SSlotView view;
+            std::memcpy(&view.state, &slot.state, sizeof(view.state));
+            std::memcpy(&view.key, &slot.key, sizeof(TKey));
+            std::memcpy(&view.value, &slot.value, sizeof(TValue));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+                return view;
+        }
+    }
+
+    // Writer only
+    void write_slot(size_t index, const TKey& key,
+                    const TValue& value) noexcept
+    {
+        SSlot& slot = slot_at(index);
+        uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+        slot.sequence.store(sequence + 1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.state = NStateUsed;
+        std::memcpy(&slot.key, &key, sizeof(TKey));
+        std::memcpy(&slot.value, &value, sizeof(TValue));
+
+        slot.sequence.store(sequence + 2u, std::memory_order_release);
+    }
+
+    // Empties a slot or makes it a tombstone; writer only
+    void clear_slot(size_t index, uint32_t state) noexcept
+    {
+        SSlot& slot = slot_at(index);
+        uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+        slot.sequence.store(sequence + 1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.state = state;
+
+        slot.sequence.store(sequence + 2u, std::memory_order_release);
+    }
+
+    // Returns the slot with `desired` or capacity if none; writer only,
+    // as it reads slots without their seqlock
+    [[nodiscard]]
+    size_t search(const TKey& desired) const noexcept;
+
+    // Drops tombstones by reinserting all elements, readers wait on the
+    // table sequence meanwhile; writer only
+    void rebuild();
+
+    void check_writable(const char* func) const
+    {
+        if (!writable_)
+            throw std::invalid_argument(
+                    std::string("CSharedMemHashTable::") + func +
+                    "(): table is opened for reading");
+    }
+
+    void swap(CSharedMemHashTable& other) noexcept
+    {
+        std::swap(hasher_, other.hasher_);
+        std::swap(base_, other.base_);
+        std::swap(length_, other.length_);
+        std::swap(writable_, other.writable_);
+        std::swap(header_, other.header_);
+        std::swap(slots_, other.slots_);
+    }
+
+private:
+    THasher hasher_{};
+
+    void* base_{};
+    size_t length_{};
+    bool writable_{};
+
+    SHeader* header_{};
+    SSlot* slots_{};
+};
+
+template<class TK, class TV, class TH>
+CSharedMemHashTable<TK, TV, TH>::
+CSharedMemHashTable(const std::string& name, size_t count):
+    writable_(true)
+{
+    size_t capacity = CPow2Capacity::round(
+            count + count / (NLoadRatio - 1u) + 1u);
+    length_ = NSlotOffset + capacity * sizeof(SSlot);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error(
+                "CSharedMemHashTable::CSharedMemHashTable(): "
+                "can not create segment " + name);
+
+    // New segment is zero filled, which is an empty slot of sequence 0
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(length_)) == 0)
+        base = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw std::runtime_error(
+                "CSharedMemHashTable::CSharedMemHashTable(): "
+                "can not map segment " + name);
+    }
+
+    base_ = base;
+    header_ = new (base_) SHeader{};
+    header_->version = NVersion;
+    header_->key_size = sizeof(TKey);
+    header_->value_size = sizeof(TValue);
+    header_->slot_size = sizeof(SSlot);
+    header_->mask = capacity - 1u;
+    header_->slot_offset = NSlotOffset;
+    header_->length = length_;
+
+    slots_ = reinterpret_cast<SSlot*>(
+            static_cast<unsigned char*>(base_) + header_->slot_offset);
+    for (size_t index = 0u; index < capacity; ++index)
+        new (&slots_[index]) SSlot{};
+
+    header_->magic.store(NMagic, std::memory_order_release);
+}
+
+template<class TK, class TV, class TH>
+CSharedMemHashTable<TK, TV, TH>::
+CSharedMemHashTable(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error(
+                "CSharedMemHashTable::CSharedMemHashTable(): "
+                "can not open segment " + name);
+
+    struct stat segment_stat{};
+    void* base = MAP_FAILED;
+    if (fstat(fd, &segment_stat) == 0 &&
+        static_cast<size_t>(segment_stat.st_size) >= sizeof(SHeader))
+    {
+        length_ = static_cast<size_t>(segment_stat.st_size);
+        base = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED)
+        throw std::runtime_error(
+                "CSharedMemHashTable::CSharedMemHashTable(): "
+                "can not map segment " + name);
+
+    base_ = base;
+    header_ = static_cast<SHeader*>(base_);
+
+    const SHeader& header = *header_;
+    if (header.magic.load(std::memory_order_acquire) != NMagic ||
+        header.version != NVersion ||
+        header.key_size != sizeof(TKey) ||
+        header.value_size != sizeof(TValue) ||
+        header.slot_size != sizeof(SSlot) ||
+        header.length != length_ ||
+        header.slot_offset + (header.mask + 1u) * sizeof(SSlot) > length_)
+    {
+        munmap(base_, length_);
+        throw std::invalid_argument(
+                "CSharedMemHashTable::CSharedMemHashTable(): "
+                "segment is not ready or not of this table type " + name);
+    }
+
+    slots_ = reinterpret_cast<SSlot*>(
+            static_cast<unsigned char*>(base_) + header.slot_offset);
+}
+
+template<class TK, class TV, class TH>
+bool CSharedMemHashTable<TK, TV, TH>::
+insert(const TKey& desired, const TValue& desired_value)
+{
+    check_writable("insert");
+
+    if (size_t found = search(desired); found != capacity())
+    {
+        write_slot(found, desired, desired_value);
+        return false;
+    }
+
+    size_t limit = capacity() * (NLoadRatio - 1u);
+    if ((header_->used + 1u) * NLoadRatio > limit)
+    {
+        if ((size() + 1u) * NLoadRatio > limit)
+            throw std::length_error(
+                    "CSharedMemHashTable::insert(): table is full");
+
+        rebuild();
+    }
+
+    // First tombstone on the way is reused, the key is known to be absent
+    size_t index = home_of(desired);
+    uint32_t state = slot_at(index).state;
+    for (; state == NStateUsed; state = slot_at(index).state)
+        index = (index + 1u) & header_->mask;
+
+    write_slot(index, desired, desired_value);
+
+    header_->used += (state == NStateEmpty);
+    header_->size.fetch_add(1u, std::memory_order_relaxed);
+
+    return true;
+}
+
+template<class TK, class TV, class TH>
+bool CSharedMemHashTable<TK, TV, TH>::
+erase(const TKey& desired)
+{
+    check_writable("erase");
+
+    size_t found = search(desired);
+    if (found == capacity())
+        return false;
+
+    clear_slot(found, NStateSkip);
+    header_->size.fetch_sub(1u, std::memory_order_relaxed);
+
+    return true;
+}
+
+template<class TK, class TV, class TH>
+std::optional<typename CSharedMemHashTable<TK, TV, TH>::TValue>
+CSharedMemHashTable<TK, TV, TH>::
+find(const TKey& desired) const
+{
+    for (;;)
+    {
+        uint64_t sequence = header_->sequence.load(std::memory_order_acquire);
+        if ((sequence & 1u) != 0u)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Slots are checked one by one, so the result holds for some
+        // moment of the lookup unless a rebuild moved elements under it
+        std::optional<TValue> result;
+        size_t index = home_of(desired);
+        for (size_t count = 0u; count <= header_->mask; ++count)
+        {
+            SSlotView view = read_slot(index);
+            if (view.state == NStateEmpty)
+                break;
+
+            if (view.state == NStateUsed && view.key == desired)
+            {
+                result = view.value;
+                break;
+            }
+
+            index = (index + 1u) & header_->mask;
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->sequence.load(std::memory_order_relaxed) == sequence)
+            return result;
+    }
+}
+
+template<class TK, class TV, class TH>
+size_t CSharedMemHashTable<TK, TV, TH>::
+search(const TKey& desired) const noexcept
+{
+    size_t index = home_of(desired);
+    for (size_t count = 0u; count <= header_->mask; ++count)
+    {
+        const SSlot& slot = slot_at(index);
+        if (slot.state == NStateEmpty)
+            break;
+
+        if (slot.state == NStateUsed && slot.key == desired)
+            return index;
+
+        index = (index + 1u) & header_->mask;
+    }
+
+    return capacity();
+}
+
+template<class TK, class TV, class TH>
+void CSharedMemHashTable<TK, TV, TH>::
+rebuild()
+{
+    std::vector<std::pair<TKey, TValue>> element_vec;
+    element_vec.reserve(size());
+    for (size_t index = 0u; index <= header_->mask; ++index)
+    {
+        if (const SSlot& slot = slot_at(index); slot.state == NStateUsed)
+            element_vec.emplace_back(slot.key, slot.value);
+    }
+
+    uint64_t sequence = header_->sequence.load(std::memory_order_relaxed);
+    header_->sequence.store(sequence + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Slot sequences keep growing, so a reader that copied a slot before
+    // the rebuild never takes the new contents for the old ones
+    for (size_t index = 0u; index <= header_->mask; ++index)
+    {
+        if (slot_at(index).state != NStateEmpty)
+            clear_slot(index, NStateEmpty);
+    }
+
+    for (const auto& [key, value] : element_vec)
+    {
+        size_t index = home_of(key);
+        while (slot_at(index).state != NStateEmpty)
+            index = (index + 1u) & header_->mask;
+
+        write_slot(index, key, value);
+    }
+
+    header_->used = element_vec.size();
+    header_->sequence.store(sequence + 2u, std::memory_order_release);
+}
+
+} // namespace
+
+#endif // SHARED_MEM_HASHTABLE_H_
@@ -0,0 +1,33 @@
+#ifndef SHRINK_POLICY_H_
+#define SHRINK_POLICY_H_
+
+#include <cstddef>
+
+namespace {
+
+// Shrink policies tell when erase gives storage back. A table shrinks once
+// fewer than capacity / NShrinkRatio elements are left, to the capacity
+// that fits twice as many as are left. Zero means that only an explicit
+// shrink_to_fit() shrinks the table.
+
+class CNoShrink
+{
+public:
+    static constexpr size_t NShrinkRatio = 0u;
+};
+
+// Shrunk table is half full at most, so it has to double before it grows
+// again and lose most of what is left before it shrinks again
+template<size_t NSR = 8u>
+class CLowWatermarkShrink
+{
+public:
+    static_assert(NSR >= 4u,
+                  "lower ratio leaves no gap between shrink and growth");
+
+    static constexpr size_t NShrinkRatio = NSR;
+};
+
+} // namespace
+
+#endif // SHRINK_POLICY_H_
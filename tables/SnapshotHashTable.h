@@ -0,0 +1,263 @@
+#ifndef SNAPSHOT_HASHTABLE_H_
+#define SNAPSHOT_HASHTABLE_H_
+
+#include "ThreadIndex.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+
+namespace {
+
+// Read-mostly wrapper over a copyable table of type TTable. Readers look
+// up an immutable published version and write only their own epoch slot,
+// so they do no atomic read-modify-write at all. Writers are serialized and
+// apply updates to a private copy, which is published after NBatch updates
+// or on publish(). Replaced versions are freed once no reader may still be
+// in an epoch that could have seen them.
+//
+// Every publish copies the whole table, so the wrapper pays off only when
+// lookups outnumber updates by far.
+template<class TTable, size_t NBatch = 1024u, size_t NReaders = 128u>
+class CSnapshotHashTable final
+{
+public:
+    using TTableType = TTable;
+    using TKey = typename TTable::TKey;
+    using TValue = typename TTable::TValue;
+
+    static_assert(NBatch > 0u, "batch must not be empty");
+    static_assert(std::is_copy_constructible_v<TTable>,
+                  "every publish copies the table");
+
+    // Reader slot value of a thread outside of a read section
+    static constexpr uint64_t NEpochIdle = 0u;
+
+    CSnapshotHashTable():
+        version_(new TTable())
+    {}
+
+    template<typename TIter>
+    CSnapshotHashTable(TIter begin_it, TIter end_it):
+        version_(new TTable(begin_it, end_it))
+    {}
+
+    CSnapshotHashTable(const CSnapshotHashTable&) = delete;
+    CSnapshotHashTable& operator = (const CSnapshotHashTable&) = delete;
+
+    // Requires no reader to be running
+    ~CSnapshotHashTable()
+    {
+        delete version_.load(std::memory_order_relaxed);
+    }
+
+    // Calls `func` with the current published version, which stays alive
+    // until `func` returns
+    template<typename TFunc>
+    decltype(auto) read(TFunc&& func) const
+    {
+        SReader* reader = reader_slot();
+        if (reader == nullptr)
+        {
+            // Threads beyond NReaders running at once are excluded from
+            // reclamation by the writer lock instead
+            std::lock_guard lock(writer_mutex_);
+            return std::forward<TFunc>(func)(
+                    std::as_const(*version_.load(std::memory_order_relaxed)));
+        }
+
+        CReadGuard guard(*this, *reader);
+        return std::forward<TFunc>(func)(std::as_const(*guard.version()));
+    }
+
+    [[nodiscard]]
+    std::optional<TValue> find(const TKey& desired) const
+    {
+        return read([&desired](const TTable& table) -> std::optional<TValue> {
+                if (auto result = table.find(desired))
+                    return result.value().get();
+
+                return std::nullopt;
+            });
+    }
+
+    // Size and capacity are those of the published version
+    [[nodiscard]]
+    size_t size() const
+    {
+        return read([](const TTable& table) { return table.size(); });
+    }
+
+    [[nodiscard]]
+    size_t capacity() const
+    {
+        return read([](const TTable& table) { return table.capacity(); });
+    }
+
+    [[nodiscard]]
+    bool empty() const
+    {
+        return size() == 0u;
+    }
+
+    // Updates are visible to readers only after the batch is published,
+    // results are exact as they come from the private copy
+    bool insert(const TKey& desired, const TValue& desired_value)
+    {
+        std::lock_guard lock(writer_mutex_);
+
+        bool result = writable().insert(desired, desired_value);
+        if (++pending_ >= NBatch)
+            publish_locked();
+
+        return result;
+    }
+
+    bool erase(const TKey& desired)
+    {
+        std::lock_guard lock(writer_mutex_);
+
+        bool result = writable().erase(desired);
+        if (++pending_ >= NBatch)
+            publish_locked();
+
+        return result;
+    }
+
+    void publish()
+    {
+        std::lock_guard lock(writer_mutex_);
+        publish_locked();
+    }
+
+protected:
+    // Each slot takes its own cache line, so readers do not false share
+    struct alignas(64) SReader
+    {
+        std::atomic<uint64_t> epoch{ NEpochIdle };
+    };
+
+    struct SRetired
+    {
+        uint64_t epoch;
+        std::unique_ptr<TTable> version;
+    };
+
+    // Announces the epoch before loading the version. Store of the epoch
+    // and the version load are both sequentially consistent, so either the
+    // writer sees the announcement or the reader sees the new version.
+    class CReadGuard
+    {
+    public:
+        CReadGuard(const CSnapshotHashTable& table, SReader& reader):
+            reader_(reader)
+        {
+            reader_.epoch.store(
+                    table.epoch_.load(std::memory_order_acquire),
+                    std::memory_order_seq_cst);
+            version_ = table.version_.load(std::memory_order_seq_cst);
+        }
+
+        CReadGuard(const CReadGuard&) = delete;
+        CReadGuard& operator = (const CReadGuard&) = delete;
+
+        ~CReadGuard()
+        {
+            reader_.epoch.store(NEpochIdle, std::memory_order_release);
+        }
+
+        [[nodiscard]]
+        const TTable* version() const noexcept
+        {
+            return version_;
+        }
+
+    private:
+        SReader& reader_;
+        const TTable* version_;
+    };
+
+    // Slot of the calling thread, the same in every table of this type;
+    // nullptr if all of them are taken by running threads
+    [[nodiscard]]
+    SReader* reader_slot() const noexcept
+    {
+        size_t index = CThreadIndex<CSnapshotHashTable, NReaders>::get();
+
+        return (index < NReaders ? &reader_vec_[index] : nullptr);
+    }
+
+    // Requires the writer lock
+    TTable& writable()
+    {
+        if (!next_)
+            next_ = std::make_unique<TTable>(
+                    *version_.load(std::memory_order_relaxed));
+
+        return *next_;
+    }
+
+    // Requires the writer lock
+    void publish_locked()
+    {
+        if (!next_)
+            return;
+
+        TTable* old_version = version_.exchange(next_.release(),
+                                                std::memory_order_seq_cst);
+
+        // Readers that announce a later epoch load the new version
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        epoch_.store(epoch + 1u, std::memory_order_seq_cst);
+
+        retired_vec_.push_back(
+                SRetired{ epoch, std::unique_ptr<TTable>(old_version) });
+        pending_ = 0u;
+
+        reclaim();
+    }
+
+    // Frees versions retired before the oldest epoch still announced
+    void reclaim()
+    {
+        uint64_t min_epoch = epoch_.load(std::memory_order_relaxed);
+        for (const SReader& reader : reader_vec_)
+        {
+            uint64_t epoch = reader.epoch.load(std::memory_order_seq_cst);
+            if (epoch != NEpochIdle && epoch < min_epoch)
+                min_epoch = epoch;
+        }
+
+        size_t kept = 0u;
+        for (SRetired& retired : retired_vec_)
+        {
+            if (retired.epoch >= min_epoch)
+                retired_vec_[kept++] = std::move(retired);
+        }
+
+        retired_vec_.resize(kept);
+    }
+
+private:
+    std::atomic<TTable*> version_;
+    std::atomic<uint64_t> epoch_{ NEpochIdle + 1u };
+
+    mutable std::vector<SReader> reader_vec_ =
+        std::vector<SReader>(NReaders);
+
+    // Writer state
+    mutable std::mutex writer_mutex_{};
+    std::unique_ptr<TTable> next_{};
+    size_t pending_{};
+    std::vector<SRetired> retired_vec_{};
+};
+
+} // namespace
+
+#endif // SNAPSHOT_HASHTABLE_H_
@@ -0,0 +1,525 @@
+#ifndef SWISS_HASHTABLE_H_
+#define SWISS_HASHTABLE_H_
+
+#include "IHashTable.h"
+#include "CapacityPolicy.h"
+
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+namespace {
+
+// Group of NWidth control bytes matched at once
+class CCtrlGroup
+{
+public:
+    static constexpr size_t NWidth = 16u;
+
+    static constexpr int8_t NCtrlEmpty = -128;
+    static constexpr int8_t NCtrlDeleted = -2;
+    // Every special control byte is less than sentinel, full ones are not
+    static constexpr int8_t NCtrlSentinel = -1;
+
+    explicit CCtrlGroup(const int8_t* ctrl) noexcept
+#ifdef __SSE2__
+        : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)))
+    {}
+#else
+        : ctrl_(ctrl)
+    {}
+#endif // __SSE2__
+
+    // Bit per slot holding fragment `h2`
+    [[nodiscard]]
+    inline uint32_t match(int8_t h2) const noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<uint32_t>(_mm_movemask_epi8(
+                    _mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+#else
+        uint32_t mask = 0u;
+        for (size_t idx = 0u; idx < NWidth; ++idx)
+            mask |= static_cast<uint32_t>(ctrl_[idx] == h2) << idx;
+
+        return mask;
+#endif // __SSE2__
+    }
+
+    [[nodiscard]]
+    inline uint32_t match_empty() const noexcept
+    {
+        return match(NCtrlEmpty);
+    }
+
+    [[nodiscard]]
+    inline uint32_t match_empty_or_deleted() const noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<uint32_t>(_mm_movemask_epi8(
+                    _mm_cmpgt_epi8(_mm_set1_epi8(NCtrlSentinel), ctrl_)));
+#else
+        uint32_t mask = 0u;
+        for (size_t idx = 0u; idx < NWidth; ++idx)
+            mask |= static_cast<uint32_t>(ctrl_[idx] < NCtrlSentinel) << idx;
+
+        return mask;
+#endif // __SSE2__
+    }
+
+    [[nodiscard]]
+    static inline size_t lowest(uint32_t mask) noexcept
+    {
+        return static_cast<size_t>(__builtin_ctz(mask));
+    }
+
+private:
+#ifdef __SSE2__
+    __m128i ctrl_;
+#else
+    const int8_t* ctrl_;
+#endif // __SSE2__
+};
+
+// Open addressing over groups of control bytes: each byte is either empty,
+// deleted or 7 low bits of the hash of the key stored in the slot
+template<class TK, class TV, class TH = std::hash<TK>, size_t NLR = 8u>
+class CSwissHashTable final : public IHashTable<TK, TV>
+{
+public:
+    using typename IHashTable<TK, TV>::TKey;
+    using typename IHashTable<TK, TV>::TValue;
+    using typename IHashTable<TK, TV>::TData;
+    using typename IHashTable<TK, TV>::TRawKey;
+    using THasher = TH;
+
+    using TStorage =
+        typename std::aligned_storage<sizeof(TData), alignof(TData)>::type;
+
+    static constexpr size_t NGroupWidth = CCtrlGroup::NWidth;
+    static constexpr size_t NStartCapacity = NGroupWidth;
+    static constexpr size_t NLoadRatio = NLR;
+    static constexpr double NRehashFactor = 2.0;
+    static constexpr bool NIsTransparent = SIsTransparent<THasher>::value;
+
+    CSwissHashTable() = default;
+
+    template<typename TIter>
+    CSwissHashTable(TIter begin_it, TIter end_it):
+        CSwissHashTable()
+    {
+        reserve(range_size(begin_it, end_it)); // Safe as class is `final`
+
+        for (TIter iter = begin_it; iter != end_it; ++iter)
+        {
+            const auto& [key, value] = *iter;
+            insert(key, value); // Safe as class is `final`
+        }
+    }
+
+    CSwissHashTable(const CSwissHashTable& other):
+        IHashTable<TK, TV>(other),
+        size_(other.size_),
+        deleted_(other.deleted_),
+        hasher_(other.hasher_),
+        ctrl_vec_(other.ctrl_vec_),
+        data_vec_(other.data_vec_.size())
+    {
+        for (size_t index = 0u; index < ctrl_vec_.size(); ++index)
+        {
+            if (ctrl_vec_[index] >= 0)
+                construct_at(index, other.get_data_at(index));
+        }
+    }
+
+    CSwissHashTable& operator = (const CSwissHashTable& other)
+    {
+        if (this != &other)
+        {
+            CSwissHashTable copy(other);
+            swap(copy);
+        }
+
+        return *this;
+    }
+
+    CSwissHashTable(CSwissHashTable&& other) noexcept:
+        CSwissHashTable()
+    {
+        swap(other);
+    }
+
+    CSwissHashTable& operator = (CSwissHashTable&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    virtual ~CSwissHashTable() final
+    {
+        for (size_t index = 0u; index < ctrl_vec_.size(); ++index)
+        {
+            if (ctrl_vec_[index] >= 0)
+                destruct_at(index);
+        }
+    }
+
+    void swap(CSwissHashTable& other) noexcept
+    {
+        std::swap(size_, other.size_);
+        std::swap(deleted_, other.deleted_);
+        std::swap(hasher_, other.hasher_);
+        std::swap(ctrl_vec_, other.ctrl_vec_);
+        std::swap(data_vec_, other.data_vec_);
+    }
+
+    [[nodiscard]]
+    virtual size_t size() const noexcept override final
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    virtual size_t capacity() const noexcept override final
+    {
+        return ctrl_vec_.size();
+    }
+
+    [[nodiscard]]
+    virtual bool empty() const noexcept override final
+    {
+        return size_ == 0u;
+    }
+
+    virtual void reserve(size_t count) override final
+    {
+        size_t new_capacity = CPow2Capacity::round(
+                std::max(capacity_for(count, NLoadRatio), NGroupWidth));
+        if (new_capacity > capacity())
+            rehash(new_capacity);
+    }
+
+    virtual bool insert(const TKey& desired,
+                        const TValue& desired_value) override final
+    {
+        return emplace_core<true>(desired, desired_value);
+    }
+
+    virtual bool erase(const TKey& desired) override final
+    {
+        return erase_core(desired);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<TValue>>
+        find(const TKey& desired) override final
+    {
+        auto result = const_cast<const CSwissHashTable&>(*this).find(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    [[nodiscard]]
+    virtual std::optional<std::reference_wrapper<const TValue>>
+        find(const TKey& desired) const override final
+    {
+        return find_core(desired);
+    }
+
+    virtual bool insert(TRawKey&& desired,
+                        TValue&& desired_value) override final
+    {
+        return emplace_core<true>(std::move(desired),
+                                  std::move(desired_value));
+    }
+
+    // Value is constructed from `args` only if the key is absent
+    template<typename... Types>
+    bool try_emplace(const TKey& desired, Types&&... args)
+    {
+        return emplace_core<false>(desired, std::forward<Types>(args)...);
+    }
+
+    template<typename... Types>
+    bool try_emplace(TRawKey&& desired, Types&&... args)
+    {
+        return emplace_core<false>(std::move(desired),
+                                   std::forward<Types>(args)...);
+    }
+
+    // The key is known only once the element is built
+    template<typename... Types>
+    bool emplace(Types&&... args)
+    {
+        std::pair<TRawKey, TValue> data(std::forward<Types>(args)...);
+        return try_emplace(std::move(data.first), std::move(data.second));
+    }
+
+    // Lookups by any type the hasher accepts, e.g. std::string_view for
+    // std::string keys
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    bool erase(const TKeyLike& desired)
+    {
+        return erase_core(desired);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<TValue>>
+        find(const TKeyLike& desired)
+    {
+        auto result = find_core(desired);
+
+        return (result ?
+                std::make_optional(
+                        std::ref(const_cast<TValue&>(result.value().get()))
+                    ) :
+                std::nullopt);
+    }
+
+    template<typename TKeyLike,
+             typename = TEnableIfKeyLike<TKeyLike, TRawKey, NIsTransparent>>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find(const TKeyLike& desired) const
+    {
+        return find_core(desired);
+    }
+
+protected:
+    using IHashTable<TK, TV>::capacity_for;
+
+    // A present key gets the value assigned if NAssign, otherwise the
+    // table is left as is
+    template<bool NAssign, typename TKeyArg, typename... Types>
+    bool emplace_core(TKeyArg&& desired, Types&&... args)
+    {
+        static_assert(!NAssign || sizeof...(Types) == 1u,
+                      "assignment takes the value alone");
+
+        size_t hash = hasher_(desired);
+        if (size_t found = search(desired, hash); found != capacity())
+        {
+            if constexpr (NAssign)
+                get_data_at(found).second = (std::forward<Types>(args), ...);
+
+            return false;
+        }
+
+        // Tombstones are counted too as they lengthen probe sequences
+        if (capacity() * (NLoadRatio - 1) < (size_ + deleted_ + 1) * NLoadRatio)
+        {
+            // Rehash in place if it is enough to drop the tombstones
+            if (capacity() * (NLoadRatio - 1) < (size_ + 1) * NLoadRatio * 2u)
+                rehash(capacity() * NRehashFactor);
+            else
+                rehash(capacity());
+        }
+
+        size_t target = find_free(hash);
+        if (ctrl_vec_[target] == CCtrlGroup::NCtrlDeleted)
+            --deleted_;
+
+        construct_at(target, std::piecewise_construct,
+                     std::forward_as_tuple(std::forward<TKeyArg>(desired)),
+                     std::forward_as_tuple(std::forward<Types>(args)...));
+        ctrl_vec_[target] = h2(hash);
+        ++size_;
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    bool erase_core(const TKeyLike& desired)
+    {
+        size_t found = search(desired, hasher_(desired));
+        if (found == capacity())
+            return false;
+
+        destruct_at(found);
+        --size_;
+
+        // If the group has an empty slot it has never been full, so no probe
+        // sequence has passed through it and the slot may become empty again
+        size_t group = found - found % NGroupWidth;
+        if (CCtrlGroup(&ctrl_vec_[group]).match_empty())
+        {
+            ctrl_vec_[found] = CCtrlGroup::NCtrlEmpty;
+        }
+        else
+        {
+            ctrl_vec_[found] = CCtrlGroup::NCtrlDeleted;
+            ++deleted_;
+        }
+
+        return true;
+    }
+
+    template<typename TKeyLike>
+    [[nodiscard]]
+    std::optional<std::reference_wrapper<const TValue>>
+        find_core(const TKeyLike& desired) const
+    {
+        if (size_t found = search(desired, hasher_(desired));
+            found != capacity())
+        {
+            auto& [key, value] = get_data_at(found);
+            return std::make_optional(std::cref(value));
+        }
+
+        return std::nullopt;
+    }
+
+    template<typename... Types>
+    inline TData* construct_at(size_t idx, Types&&... args)
+    {
+        return new (&data_vec_[idx]) TData{ std::forward<Types>(args)... };
+    }
+
+    inline void destruct_at(size_t idx)
+    {
+        std::launder(reinterpret_cast<TData*>(&data_vec_[idx]))->~TData();
+    }
+
+    [[nodiscard]]
+    inline const TData& get_data_at(size_t idx) const noexcept
+    {
+        return const_cast<CSwissHashTable*>(this)->get_data_at(idx);
+    }
+
+    [[nodiscard]]
+    inline TData& get_data_at(size_t idx) noexcept
+    {
+        return *std::launder(reinterpret_cast<TData*>(&data_vec_[idx]));
+    }
+
+    // Group index is taken from the high bits, control byte from the low ones
+    [[nodiscard]]
+    static inline size_t h1(size_t hash) noexcept
+    {
+        return hash >> 7u;
+    }
+
+    [[nodiscard]]
+    static inline int8_t h2(size_t hash) noexcept
+    {
+        return static_cast<int8_t>(hash & 0x7Fu);
+    }
+
+    // Triangular numbers visit every group as the group count is a power of 2
+    [[nodiscard]]
+    inline size_t run(size_t group, size_t count) const noexcept
+    {
+        return (group + count) & (capacity() / NGroupWidth - 1u);
+    }
+
+    // Returns index of the slot holding `desired` or capacity() if none
+    template<typename TKeyLike>
+    [[nodiscard]]
+    size_t search(const TKeyLike& desired, size_t hash) const noexcept
+    {
+        size_t group_count = capacity() / NGroupWidth;
+        size_t group = h1(hash) & (group_count - 1u);
+        for (size_t count = 0u; count < group_count;
+             ++count, group = run(group, count))
+        {
+            size_t base = group * NGroupWidth;
+            CCtrlGroup ctrl_group(&ctrl_vec_[base]);
+
+            for (uint32_t mask = ctrl_group.match(h2(hash)); mask != 0u;
+                 mask &= mask - 1u)
+            {
+                size_t index = base + CCtrlGroup::lowest(mask);
+                if (auto& [key, value] = get_data_at(index); key == desired)
+                    return index;
+            }
+
+            if (ctrl_group.match_empty())
+                break;
+        }
+
+        return capacity();
+    }
+
+    // Returns index of the first empty or deleted slot on the probe sequence
+    [[nodiscard]]
+    size_t find_free(size_t hash) const noexcept
+    {
+        size_t group_count = capacity() / NGroupWidth;
+        size_t group = h1(hash) & (group_count - 1u);
+        for (size_t count = 0u; ; ++count, group = run(group, count))
+        {
+            size_t base = group * NGroupWidth;
+            if (uint32_t mask =
+                    CCtrlGroup(&ctrl_vec_[base]).match_empty_or_deleted();
+                mask != 0u)
+                return base + CCtrlGroup::lowest(mask);
+        }
+    }
+
+    void rehash(size_t new_capacity)
+    {
+        if (new_capacity % NGroupWidth != 0u ||
+            new_capacity * (NLoadRatio - 1) < size_ * NLoadRatio)
+            throw std::invalid_argument(
+                    "CSwissHashTable::rehash(): "
+                    "invalid new_capacity"
+                    );
+
+        auto old_ctrl_vec =
+            std::vector<int8_t>(new_capacity, CCtrlGroup::NCtrlEmpty);
+        auto old_data_vec = std::vector<TStorage>(new_capacity);
+
+        std::swap(ctrl_vec_, old_ctrl_vec);
+        std::swap(data_vec_, old_data_vec);
+        deleted_ = 0u;
+
+        for (size_t index = 0u; index < old_ctrl_vec.size(); ++index)
+        {
+            if (old_ctrl_vec[index] >= 0)
+            {
+                TData* ptr = std::launder(
+                        reinterpret_cast<TData*>(&old_data_vec[index]));
+
+                auto& [key, value] = *ptr;
+                size_t hash = hasher_(key);
+                size_t target = find_free(hash);
+
+                construct_at(target, key, std::move(value));
+                ctrl_vec_[target] = h2(hash);
+
+                ptr->~TData();
+            }
+        }
+    }
+
+private:
+    size_t size_{};
+    size_t deleted_{};
+    THasher hasher_{};
+
+    std::vector<int8_t> ctrl_vec_ =
+        std::vector<int8_t>(NStartCapacity, CCtrlGroup::NCtrlEmpty);
+    std::vector<TStorage> data_vec_ = std::vector<TStorage>(NStartCapacity);
+};
+
+} // namespace
+
+#endif // SWISS_HASHTABLE_H_
@@ -0,0 +1,110 @@
+#ifndef THREAD_INDEX_H_
+#define THREAD_INDEX_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace {
+
+// Hands out indexes below NCount to threads, one per thread for every
+// TTag, and takes them back when the thread exits, so pools that recycle
+// threads never run out of them. Threads that come when every index is
+// taken get NNone and try again once some thread has returned its index.
+template<class TTag, size_t NCount>
+class CThreadIndex final
+{
+public:
+    static constexpr size_t NNone = NCount;
+
+    CThreadIndex() = delete;
+
+    [[nodiscard]]
+    static size_t get()
+    {
+        static thread_local CHolder holder;
+
+        if (holder.index == NNone &&
+            pool().free_count.load(std::memory_order_relaxed) != 0u)
+            holder.index = acquire();
+
+        return holder.index;
+    }
+
+private:
+    // Returned indexes never need more room than reserved, so a thread
+    // exit does not allocate
+    struct SPool
+    {
+        SPool()
+        {
+            free_vec.reserve(NCount);
+        }
+
+        std::mutex mutex;
+        std::vector<size_t> free_vec;
+        std::atomic<size_t> free_count{};
+        size_t next_index{};
+    };
+
+    class CHolder
+    {
+    public:
+        CHolder():
+            index(acquire())
+        {}
+
+        CHolder(const CHolder&) = delete;
+        CHolder& operator = (const CHolder&) = delete;
+
+        ~CHolder()
+        {
+            if (index != NNone)
+                release(index);
+        }
+
+        size_t index;
+    };
+
+    [[nodiscard]]
+    static SPool& pool()
+    {
+        static SPool pool;
+        return pool;
+    }
+
+    [[nodiscard]]
+    static size_t acquire()
+    {
+        SPool& shared = pool();
+        std::lock_guard lock(shared.mutex);
+
+        if (!shared.free_vec.empty())
+        {
+            size_t index = shared.free_vec.back();
+            shared.free_vec.pop_back();
+            shared.free_count.store(shared.free_vec.size(),
+                                    std::memory_order_relaxed);
+
+            return index;
+        }
+
+        return (shared.next_index < NCount ?
+                shared.next_index++ : NNone);
+    }
+
+    static void release(size_t index)
+    {
+        SPool& shared = pool();
+        std::lock_guard lock(shared.mutex);
+
+        shared.free_vec.push_back(index);
+        shared.free_count.store(shared.free_vec.size(),
+                                std::memory_order_relaxed);
+    }
+};
+
+} // namespace
+
+#endif // THREAD_INDEX_H_
@@ -0,0 +1,412 @@
+#include "ConcurrentCuckooHashTable.h"
+#include "LockFreeHashTable.h"
+#include "ShardedHashTable.h"
+#include "OpenLinearAddrHashTable.h"
+#include "SnapshotHashTable.h"
+#include "CuckooHashTable.h"
+#include "SharedMemHashTable.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <random>
+#include <functional>
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t NWriters = 4u;
+static constexpr size_t NReaders = 2u;
+static constexpr size_t NKeys = size_t{ 1u } << 16u;
+static constexpr uint32_t NRounds = 16u;
+static constexpr size_t NSnapshotKeys = 1024u;
+static constexpr size_t NResizeThreads = 16u;
+
+// Readers tell the key a value belongs to, whichever round wrote it
+static inline uint32_t value_of(size_t key, uint32_t round)
+{
+    return static_cast<uint32_t>(key) * NRounds + round;
+}
+
+// Every writer owns the keys equal to its index modulo NWriters, so it
+// knows what each of them must hold after every step. Every round inserts
+// all of them and erases them again, except for odd keys in the last round.
+// Readers look up random keys meanwhile and check that a found value
+// belongs to its key.
+template<class TTable>
+bool check_table(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    std::atomic<bool> failed{ false };
+    std::atomic<size_t> writers_left{ NWriters };
+
+    auto writer = [&ht, &failed, &writers_left, key_count](size_t first)
+    {
+        for (uint32_t round = 0u; round < NRounds; ++round)
+        {
+            for (size_t key = first; key < key_count; key += NWriters)
+            {
+                if (!ht.insert(key, value_of(key, round)))
+                    failed = true;
+            }
+
+            for (size_t key = first; key < key_count; key += NWriters)
+            {
+                auto found = ht.find(key);
+                if (!found || *found != value_of(key, round))
+                    failed = true;
+            }
+
+            bool last = (round + 1u == NRounds);
+            for (size_t key = first; key < key_count; key += NWriters)
+            {
+                if (last && key % 2u == 1u)
+                    continue;
+
+                if (!ht.erase(key) || ht.find(key))
+                    failed = true;
+            }
+        }
+
+        --writers_left;
+    };
+
+    auto reader = [&ht, &failed, &writers_left, key_count](size_t seed)
+    {
+        std::mt19937 rand_gen(static_cast<uint32_t>(seed));
+        std::uniform_int_distribution<size_t> distr(0u, key_count - 1u);
+        while (writers_left.load() != 0u)
+        {
+            size_t key = distr(rand_gen);
+            if (auto found = ht.find(key); found && *found / NRounds != key)
+                failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t index = 0u; index < NWriters; ++index)
+        threads.emplace_back(writer, index);
+    for (size_t index = 0u; index < NReaders; ++index)
+        threads.emplace_back(reader, index);
+    for (auto& thread : threads)
+        thread.join();
+
+    if (ht.size() != key_count / 2u)
+        failed = true;
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        auto found = ht.find(key);
+        if (key % 2u == 1u ?
+            !found || *found != value_of(key, NRounds - 1u) :
+            found.has_value())
+            failed = true;
+    }
+
+    std::cerr << name << (failed ? ": FAILED\n" : ": OK\n");
+
+    return !failed;
+}
+
+// Threads start from the smallest table and insert keys until it has
+// grown many times, so resizes start while other threads are still
+// copying chunks of the last one. Every key must be found right after its
+// insert and after every wave. A second wave of new threads erases even
+// keys and assigns odd ones. There are more threads than thread slots of
+// the table, so slots are given back and taken again, and some threads run
+// without one.
+template<class TTable>
+bool check_resize(const char* name, size_t key_count = 4u * NKeys)
+{
+    TTable ht;
+    std::atomic<bool> failed{ false };
+    std::atomic<bool> done{ false };
+
+    auto inserter = [&ht, &failed, key_count](size_t first)
+    {
+        for (size_t key = first; key < key_count; key += NResizeThreads)
+        {
+            if (!ht.insert(key, value_of(key, 0u)))
+                failed = true;
+
+            auto found = ht.find(key);
+            if (!found || *found != value_of(key, 0u))
+                failed = true;
+        }
+
+        for (size_t key = first; key < key_count; key += NResizeThreads)
+        {
+            auto found = ht.find(key);
+            if (!found || *found != value_of(key, 0u))
+                failed = true;
+        }
+    };
+
+    auto updater = [&ht, &failed, key_count](size_t first)
+    {
+        for (size_t key = first; key < key_count; key += NResizeThreads)
+        {
+            if (key % 2u == 0u ?
+                !ht.erase(key) || ht.find(key) :
+                ht.insert(key, value_of(key, 1u)))
+                failed = true;
+        }
+    };
+
+    auto reader = [&ht, &failed, &done, key_count](size_t seed)
+    {
+        std::mt19937 rand_gen(static_cast<uint32_t>(seed));
+        std::uniform_int_distribution<size_t> distr(0u, key_count - 1u);
+        while (!done.load())
+        {
+            size_t key = distr(rand_gen);
+            if (auto found = ht.find(key); found && *found / NRounds != key)
+                failed = true;
+        }
+    };
+
+    std::vector<std::thread> reader_threads;
+    for (size_t index = 0u; index < NReaders; ++index)
+        reader_threads.emplace_back(reader, index);
+
+    for (const auto& wave : { std::function<void(size_t)>(inserter),
+                              std::function<void(size_t)>(updater) })
+    {
+        std::vector<std::thread> threads;
+        for (size_t index = 0u; index < NResizeThreads; ++index)
+            threads.emplace_back(wave, index);
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    done = true;
+    for (auto& thread : reader_threads)
+        thread.join();
+
+    // Growing from NStartCapacity to at least key_count takes a resize per
+    // doubling
+    if (ht.size() != key_count / 2u || ht.capacity() < key_count)
+        failed = true;
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        auto found = ht.find(key);
+        if (key % 2u == 1u ?
+            !found || *found != value_of(key, 1u) :
+            found.has_value())
+            failed = true;
+    }
+
+    std::cerr << name << (failed ? ": FAILED\n" : ": OK\n");
+
+    return !failed;
+}
+
+// The writer moves every key to the next round and publishes it as one
+// update. Before the publish a lookup must still find the old round, after
+// it the new one. Readers check inside one version that sampled keys all
+// hold the same round, which lies between the round published before the
+// read and the round that may be publishing after it.
+template<class TTable>
+bool check_snapshot(const char* name, size_t key_count = NSnapshotKeys)
+{
+    std::vector<std::pair<size_t, uint32_t>> element_vec;
+    for (size_t key = 0u; key < key_count; ++key)
+        element_vec.emplace_back(key, value_of(key, 0u));
+
+    TTable ht(element_vec.begin(), element_vec.end());
+    std::atomic<bool> failed{ false };
+    std::atomic<bool> done{ false };
+    std::atomic<uint32_t> published{ 0u };
+    std::atomic<uint32_t> publishing{ 0u };
+
+    auto reader = [&ht, &failed, &done, &published, &publishing,
+                   key_count](size_t seed)
+    {
+        std::mt19937 rand_gen(static_cast<uint32_t>(seed));
+        std::uniform_int_distribution<size_t> distr(0u, key_count - 1u);
+        while (!done.load())
+        {
+            uint32_t before = published.load();
+            uint32_t round = ht.read([&](const auto& table) {
+                    auto first = table.find(distr(rand_gen));
+                    uint32_t first_round = (first ?
+                                            first->get() % NRounds :
+                                            NRounds);
+                    for (size_t count = 0u; count < 16u; ++count)
+                    {
+                        size_t key = distr(rand_gen);
+                        auto found = table.find(key);
+                        if (!found || found->get() / NRounds != key ||
+                            found->get() % NRounds != first_round)
+                            failed = true;
+                    }
+
+                    return first_round;
+                });
+            uint32_t after = publishing.load();
+
+            if (round < before || round > after)
+                failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t index = 0u; index < NReaders; ++index)
+        threads.emplace_back(reader, index);
+
+    for (uint32_t round = 1u; round < NRounds; ++round)
+    {
+        // The last update may fill the batch and publish on its own
+        for (size_t key = 0u; key + 1u < key_count; ++key)
+            ht.insert(key, value_of(key, round));
+
+        for (size_t key = 0u; key < key_count; ++key)
+        {
+            auto found = ht.find(key);
+            if (!found || *found != value_of(key, round - 1u))
+                failed = true;
+        }
+
+        publishing = round;
+        ht.insert(key_count - 1u, value_of(key_count - 1u, round));
+        ht.publish();
+        published = round;
+
+        for (size_t key = 0u; key < key_count; ++key)
+        {
+            auto found = ht.find(key);
+            if (!found || *found != value_of(key, round))
+                failed = true;
+        }
+    }
+
+    done = true;
+    for (auto& thread : threads)
+        thread.join();
+
+    if (ht.size() != key_count)
+        failed = true;
+
+    std::cerr << name << (failed ? ": FAILED\n" : ": OK\n");
+
+    return !failed;
+}
+
+// The table has a single writer, so one process runs the writer rounds
+// above over all keys while reader processes check every value they find.
+// Key NKeys tells readers to stop.
+bool check_shared_mem(const char* name)
+{
+    using TTable = CSharedMemHashTable<size_t, uint32_t>;
+
+    std::string segment = "/concurrenttest." + std::to_string(getpid());
+    TTable::unlink(segment);
+
+    TTable ht(segment, NKeys + 1u);
+    bool failed = false;
+
+    std::vector<pid_t> readers;
+    for (size_t index = 0u; index < NReaders; ++index)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            TTable reader_ht(segment);
+            std::mt19937 rand_gen(static_cast<uint32_t>(index));
+            std::uniform_int_distribution<size_t> distr(0u, NKeys - 1u);
+            bool reader_failed = false;
+            while (!reader_ht.find(NKeys))
+            {
+                size_t key = distr(rand_gen);
+                if (auto found = reader_ht.find(key);
+                    found && *found / NRounds != key)
+                    reader_failed = true;
+            }
+
+            _exit(reader_failed ? 1 : 0);
+        }
+
+        if (pid < 0)
+            failed = true;
+        else
+            readers.push_back(pid);
+    }
+
+    for (uint32_t round = 0u; round < NRounds; ++round)
+    {
+        for (size_t key = 0u; key < NKeys; ++key)
+        {
+            if (!ht.insert(key, value_of(key, round)))
+                failed = true;
+        }
+
+        for (size_t key = 0u; key < NKeys; ++key)
+        {
+            auto found = ht.find(key);
+            if (!found || *found != value_of(key, round))
+                failed = true;
+        }
+
+        bool last = (round + 1u == NRounds);
+        for (size_t key = 0u; key < NKeys; ++key)
+        {
+            if (last && key % 2u == 1u)
+                continue;
+
+            if (!ht.erase(key) || ht.find(key))
+                failed = true;
+        }
+    }
+
+    ht.insert(NKeys, 0u);
+    for (pid_t pid : readers)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = true;
+    }
+
+    if (ht.size() != NKeys / 2u + 1u)
+        failed = true;
+
+    TTable::unlink(segment);
+
+    std::cerr << name << (failed ? ": FAILED\n" : ": OK\n");
+
+    return !failed;
+}
+
+int main()
+{
+    bool passed = true;
+
+    passed &= check_table<CConcurrentCuckooHashTable<size_t, uint32_t>>(
+            "CONCURRENT CUCKOO");
+    passed &= check_table<CLockFreeHashTable<size_t, uint32_t>>(
+            "LOCK FREE");
+    passed &= check_resize<
+        CLockFreeHashTable<size_t, uint32_t, std::hash<size_t>, 4u>>(
+            "LOCK FREE RESIZE");
+    passed &= check_table<CShardedHashTable<
+        COpenLinearAddrHashTable<size_t, uint32_t>>>("SHARDED");
+    // Every update is published at once, so the writers see their own
+    // updates, and every publish copies the table, so there are few keys
+    passed &= check_table<CSnapshotHashTable<
+        CCuckooHashTable<size_t, uint32_t>, 1u>>("SNAPSHOT", NKeys / 64u);
+
+    passed &= check_snapshot<CSnapshotHashTable<
+        CCuckooHashTable<size_t, uint32_t>, NSnapshotKeys>>(
+            "SNAPSHOT BATCH");
+    passed &= check_snapshot<CSnapshotHashTable<
+        CCuckooHashTable<size_t, uint32_t>, 4u * NSnapshotKeys>>(
+            "SNAPSHOT PUBLISH");
+
+    passed &= check_shared_mem("SHARED MEMORY");
+
+    return (passed ? 0 : 1);
+}
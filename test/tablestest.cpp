@@ -1,31 +1,591 @@
-// #include "ChainHashTable.h"
-// #include "OpenLinearAddrHashTable.h"
-// #include "OpenQuadroAddrHashTable.h"
-// #include "OpenDoubleAddrHashTable.h"
+#include "ChainHashTable.h"
+#include "OpenLinearAddrHashTable.h"
+#include "OpenQuadroAddrHashTable.h"
+#include "OpenDoubleAddrHashTable.h"
 #include "CuckooHashTable.h"
- 
+#include "SwissHashTable.h"
+#include "RobinHoodHashTable.h"
+#include "BucketCuckooHashTable.h"
+#include "DaryCuckooHashTable.h"
+#include "HopscotchHashTable.h"
+#include "PerfectHashTable.h"
+#include "MappedHashTable.h"
+#include "HasherAdapter.h"
+#include "Murmur3Hasher.h"
+
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <random>
 #include <iostream>
 #include <fstream>
 #include <string>
- 
-int main()
+#include <string_view>
+#include <filesystem>
+#include <cstdint>
+
+static constexpr size_t NKeys = 4096u;
+static constexpr size_t NOps = size_t{ 1u } << 17u;
+
+// Sends every key to one of two hash values, so no eviction or growth
+// makes room for more than a few of them
+struct SCollidingHasher
+{
+    [[nodiscard]]
+    size_t operator()(size_t key) const noexcept
+    {
+        return key & 1u;
+    }
+};
+
+static bool report(const char* name, bool failed)
+{
+    std::cerr << name << (failed ? ": FAILED\n" : ": OK\n");
+    return !failed;
+}
+
+// Every key below `key_count` is looked up, so a table that lost or kept
+// a key differs from the reference
+template<class TTable>
+bool same_as(const TTable& ht,
+             const std::unordered_map<size_t, std::string>& reference,
+             size_t key_count)
+{
+    if (ht.size() != reference.size())
+        return false;
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        auto found = ht.find(key);
+        auto expected = reference.find(key);
+        if (found.has_value() != (expected != reference.end()) ||
+            (found && found->get() != expected->second))
+            return false;
+    }
+
+    return true;
+}
+
+// Applies the same random inserts, erases and lookups to the table and to
+// std::unordered_map and compares every result. Values are strings, so
+// elements that are moved or destroyed twice show up as wrong values.
+template<class TTable>
+bool check_random_ops(const char* name, size_t key_count = NKeys,
+                      size_t op_count = NOps)
+{
+    TTable ht;
+    std::unordered_map<size_t, std::string> reference;
+    bool failed = false;
+
+    std::mt19937 rand_gen(static_cast<uint32_t>(key_count));
+    std::uniform_int_distribution<size_t> key_distr(0u, key_count - 1u);
+    std::uniform_int_distribution<int> op_distr(0, 9);
+
+    for (size_t op = 0u; op < op_count && !failed; ++op)
+    {
+        size_t key = key_distr(rand_gen);
+        switch (int kind = op_distr(rand_gen); kind)
+        {
+        case 0: case 1: case 2: case 3:
+        {
+            std::string value = std::to_string(op);
+            failed |= (ht.insert(key, value) !=
+                       reference.insert_or_assign(key, value).second);
+            break;
+        }
+        case 4: case 5: case 6:
+            failed |= (ht.erase(key) != (reference.erase(key) != 0u));
+            break;
+        default:
+        {
+            auto found = ht.find(key);
+            auto expected = reference.find(key);
+            failed |= (found.has_value() != (expected != reference.end()) ||
+                       (found && found->get() != expected->second));
+            break;
+        }
+        }
+
+        if (op % (op_count / 16u) == 0u)
+            failed |= !same_as(ht, reference, key_count);
+    }
+
+    failed |= !same_as(ht, reference, key_count);
+
+    return report(name, failed);
+}
+
+// Erases the oldest key and inserts a new one at every step, so the size
+// stays the same. Tables that erase without tombstones never grow then,
+// and every key of the window must stay found.
+template<class TTable>
+bool check_steady_churn(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    bool failed = false;
+
+    for (size_t key = 0u; key < key_count; ++key)
+        ht.insert(key, std::to_string(key));
+
+    size_t capacity = ht.capacity();
+    for (size_t key = key_count; key < NOps && !failed; ++key)
+    {
+        failed |= !ht.erase(key - key_count);
+        failed |= !ht.insert(key, std::to_string(key));
+        failed |= (ht.capacity() != capacity);
+    }
+
+    for (size_t key = NOps - key_count; key < NOps; ++key)
+    {
+        auto found = ht.find(key);
+        failed |= (!found || found->get() != std::to_string(key));
+    }
+
+    failed |= (ht.size() != key_count || ht.find(NOps - key_count - 1u));
+
+    return report(name, failed);
+}
+
+// Keys of a colliding hasher must all be found, with the table growing
+// only to a small multiple of their count
+template<class TTable>
+bool check_colliding(const char* name, size_t key_count = 512u)
+{
+    TTable ht;
+    bool failed = false;
+
+    for (size_t key = 0u; key < key_count; ++key)
+        failed |= !ht.insert(key, std::to_string(key));
+
+    failed |= (ht.capacity() > 16u * key_count);
+
+    for (size_t key = 0u; key < key_count; key += 2u)
+        failed |= !ht.erase(key);
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        auto found = ht.find(key);
+        failed |= (key % 2u == 0u ?
+                   found.has_value() :
+                   !found || found->get() != std::to_string(key));
+    }
+
+    failed |= (ht.size() != key_count / 2u);
+
+    return report(name, failed);
+}
+
+// Copy is taken with erased slots or nodes in the table and then both
+// tables are updated, so the copy must neither share nor lose elements
+template<class TTable>
+bool check_copy(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    bool failed = false;
+
+    for (size_t key = 0u; key < key_count; ++key)
+        ht.insert(key, std::to_string(key));
+    for (size_t key = 0u; key < key_count; key += 3u)
+        ht.erase(key);
+
+    TTable copy(ht);
+    for (size_t key = 1u; key < key_count; key += 3u)
+        ht.erase(key);
+    for (size_t key = key_count; key < 2u * key_count; ++key)
+        copy.insert(key, std::to_string(key));
+
+    for (size_t key = 0u; key < 2u * key_count; ++key)
+    {
+        auto found = ht.find(key);
+        failed |= (key % 3u == 2u && key < key_count ?
+                   !found || found->get() != std::to_string(key) :
+                   found.has_value());
+
+        auto copy_found = copy.find(key);
+        failed |= (key % 3u == 0u && key < key_count ?
+                   copy_found.has_value() :
+                   !copy_found ||
+                   copy_found->get() != std::to_string(key));
+    }
+
+    return report(name, failed);
+}
+
+// Batches of random keys, duplicates included, go through the batched
+// operations of IHashTable, whose results must match the single
+// operations applied to the reference in order
+template<class TTable>
+bool check_batches(const char* name, size_t key_count = NKeys)
+{
+    using TBatchResult = std::optional<std::reference_wrapper<std::string>>;
+    using TConstBatchResult =
+        std::optional<std::reference_wrapper<const std::string>>;
+
+    static constexpr size_t NBatch = 100u;
+
+    TTable table;
+    IHashTable<size_t, std::string>& ht = table;
+    std::unordered_map<size_t, std::string> reference;
+    bool failed = false;
+
+    std::mt19937 rand_gen(static_cast<uint32_t>(key_count));
+    std::uniform_int_distribution<size_t> key_distr(0u, key_count - 1u);
+
+    std::vector<size_t> key_vec(NBatch);
+    std::vector<std::string> value_vec(NBatch);
+    std::vector<TBatchResult> result_vec(NBatch);
+    std::vector<TConstBatchResult> const_result_vec(NBatch);
+
+    for (size_t round = 0u; round < NOps / NBatch && !failed; ++round)
+    {
+        for (size_t index = 0u; index < NBatch; ++index)
+        {
+            key_vec[index] = key_distr(rand_gen);
+            value_vec[index] = std::to_string(round * NBatch + index);
+        }
+
+        size_t expected = 0u;
+        if (round % 3u != 2u)
+        {
+            for (size_t index = 0u; index < NBatch; ++index)
+                expected += reference.insert_or_assign(
+                        key_vec[index], value_vec[index]).second;
+
+            failed |= (ht.insert_batch(key_vec.data(), value_vec.data(),
+                                       NBatch) != expected);
+        }
+        else
+        {
+            for (size_t index = 0u; index < NBatch; ++index)
+                expected += reference.erase(key_vec[index]);
+
+            failed |= (ht.erase_batch(key_vec.data(), NBatch) != expected);
+        }
+
+        for (size_t index = 0u; index < NBatch; ++index)
+            key_vec[index] = key_distr(rand_gen);
+
+        size_t found_count =
+            ht.find_batch(key_vec.data(), NBatch, result_vec.data());
+        size_t const_found_count =
+            std::as_const(ht).find_batch(key_vec.data(), NBatch,
+                                         const_result_vec.data());
+
+        expected = 0u;
+        for (size_t index = 0u; index < NBatch; ++index)
+        {
+            auto found = reference.find(key_vec[index]);
+            bool is_found = (found != reference.end());
+            expected += is_found;
+
+            failed |= (result_vec[index].has_value() != is_found ||
+                       const_result_vec[index].has_value() != is_found);
+            if (is_found && result_vec[index] && const_result_vec[index])
+                failed |= (result_vec[index]->get() != found->second ||
+                           const_result_vec[index]->get() != found->second);
+        }
+
+        failed |= (found_count != expected || const_found_count != expected);
+    }
+
+    failed |= !same_as(table, reference, key_count);
+
+    return report(name, failed);
+}
+
+// String keys are looked up and erased by std::string_view through the
+// transparent hasher, and emplacement must construct the value only for
+// an absent key
+template<class TTable>
+bool check_heterogeneous(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    bool failed = false;
+
+    auto key_of = [](size_t key) { return "key" + std::to_string(key); };
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        std::string key_str = key_of(key);
+        std::string value = std::to_string(key);
+        failed |= (key % 2u == 0u ?
+                   !ht.insert(std::move(key_str), std::move(value)) :
+                   !ht.try_emplace(key_str, value));
+    }
+
+    for (size_t key = 0u; key < key_count; ++key)
+        failed |= ht.try_emplace(key_of(key), "other");
+
+    failed |= !ht.emplace(std::string("new"), std::string("value"));
+    failed |= ht.emplace(std::string("new"), std::string("other"));
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        std::string key_str = key_of(key);
+        auto found = ht.find(std::string_view(key_str));
+        failed |= (!found || found->get() != std::to_string(key));
+    }
+
+    auto found = ht.find(std::string_view("new"));
+    failed |= (!found || found->get() != "value");
+    failed |= ht.find(std::string_view("absent")).has_value();
+
+    for (size_t key = 0u; key < key_count; key += 2u)
+    {
+        std::string key_str = key_of(key);
+        failed |= !ht.erase(std::string_view(key_str));
+        failed |= ht.erase(std::string_view(key_str));
+        failed |= ht.find(std::string_view(key_str)).has_value();
+    }
+
+    failed |= (ht.size() != key_count / 2u + 1u);
+
+    return report(name, failed);
+}
+
+// Table that reserved room for `key_count` keys takes them without
+// growing, never shrinks on a smaller reserve(), and a table built from
+// a range of that size gets the same room at once
+template<class TTable>
+bool check_reserve(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    bool failed = false;
+
+    ht.reserve(key_count);
+    size_t capacity = ht.capacity();
+
+    std::vector<std::pair<size_t, std::string>> element_vec;
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        element_vec.emplace_back(key, std::to_string(key));
+        failed |= !ht.insert(key, std::to_string(key));
+        failed |= (ht.capacity() != capacity);
+    }
+
+    ht.reserve(key_count / 2u);
+    failed |= (ht.capacity() != capacity);
+
+    TTable built(element_vec.begin(), element_vec.end());
+    failed |= (built.capacity() != capacity);
+
+    std::unordered_map<size_t, std::string> reference(element_vec.begin(),
+                                                      element_vec.end());
+    failed |= !same_as(ht, reference, key_count);
+    failed |= !same_as(built, reference, key_count);
+
+    return report(name, failed);
+}
+
+// TTable shrinks on erase and TFixed does not. Erasing most keys must
+// shrink the first, and a key inserted and erased again and again at the
+// new size must not make it shrink and grow back. shrink_to_fit() must
+// give the second the capacity reserve() gives for what is left.
+template<class TTable, class TFixed>
+bool check_shrink(const char* name, size_t key_count = NKeys)
+{
+    TTable ht;
+    TFixed fixed;
+    bool failed = false;
+
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        ht.insert(key, std::to_string(key));
+        fixed.insert(key, std::to_string(key));
+    }
+
+    size_t peak_capacity = ht.capacity();
+    for (size_t key = key_count / 16u; key < key_count; ++key)
+    {
+        failed |= !ht.erase(key);
+        failed |= !fixed.erase(key);
+    }
+
+    size_t capacity = ht.capacity();
+    failed |= (capacity >= peak_capacity);
+    failed |= (fixed.capacity() != peak_capacity);
+
+    for (size_t round = 0u; round < key_count; ++round)
+    {
+        failed |= !ht.insert(key_count, "extra");
+        failed |= !ht.erase(key_count);
+        failed |= (ht.capacity() != capacity);
+    }
+
+    fixed.shrink_to_fit();
+    TFixed reserved;
+    reserved.reserve(key_count / 16u);
+    failed |= (fixed.capacity() != reserved.capacity());
+
+    std::unordered_map<size_t, std::string> reference;
+    for (size_t key = 0u; key < key_count / 16u; ++key)
+        reference.emplace(key, std::to_string(key));
+
+    failed |= !same_as(ht, reference, key_count);
+    failed |= !same_as(fixed, reference, key_count);
+
+    return report(name, failed);
+}
+
+// Table is built from a range where every fourth key comes again later
+// with another value, which must win. Every key must be found and keys
+// past the range must miss, and so must any key of an empty table.
+template<class TTable>
+bool check_perfect(const char* name, size_t key_count = NKeys)
+{
+    std::vector<std::pair<size_t, std::string>> element_vec;
+    for (size_t key = 0u; key < key_count; ++key)
+        element_vec.emplace_back(key, std::to_string(key));
+    for (size_t key = 0u; key < key_count; key += 4u)
+        element_vec.emplace_back(key, "later");
+
+    const TTable ht(element_vec.begin(), element_vec.end());
+    bool failed = (ht.size() != key_count);
+
+    for (size_t key = 0u; key < 2u * key_count; ++key)
+    {
+        auto found = ht.find(key);
+        if (key >= key_count)
+            failed |= found.has_value();
+        else
+            failed |= (!found ||
+                       found->get() != (key % 4u == 0u ?
+                                        "later" : std::to_string(key)));
+    }
+
+    const TTable empty(element_vec.end(), element_vec.end());
+    failed |= (!empty.empty() || empty.find(0u).has_value());
+
+    return report(name, failed);
+}
+
+// String keys are looked up by std::string_view, and values may be
+// changed in place through a non-const table
+template<class TTable>
+bool check_perfect_strings(const char* name, size_t key_count = NKeys)
+{
+    std::vector<std::pair<std::string, std::string>> element_vec;
+    for (size_t key = 0u; key < key_count; ++key)
+        element_vec.emplace_back("key" + std::to_string(key),
+                                 std::to_string(key));
+
+    TTable ht(element_vec.begin(), element_vec.end());
+    bool failed = (ht.size() != key_count);
+
+    for (const auto& [key, value] : element_vec)
+    {
+        auto found = ht.find(std::string_view(key));
+        failed |= (!found || found->get() != value);
+        if (found)
+            found->get() += "!";
+    }
+
+    for (const auto& [key, value] : element_vec)
+    {
+        auto found = std::as_const(ht).find(key);
+        failed |= (!found || found->get() != value + "!");
+    }
+
+    failed |= ht.find(std::string_view("absent")).has_value();
+
+    return report(name, failed);
+}
+
+// Saves a table, changes it and saves it again over the same file. The
+// first mapping must keep the old contents and the second one must have
+// the new ones, both matching std::unordered_map key by key.
+template<class TTable>
+bool check_mapped(const char* name, size_t key_count = NKeys)
+{
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("tablestest_" + std::to_string(getpid()) +
+                         ".map")).string();
+
+    auto same_as_mapped = [key_count](
+            const CMappedHashTable<TTable>& mapped,
+            const std::unordered_map<size_t, uint32_t>& reference) {
+            if (mapped.size() != reference.size())
+                return false;
+
+            for (size_t key = 0u; key < 2u * key_count; ++key)
+            {
+                auto found = mapped.find(key);
+                auto expected = reference.find(key);
+                if (found.has_value() != (expected != reference.end()) ||
+                    (found && found->get() != expected->second))
+                    return false;
+            }
+
+            return true;
+        };
+
+    TTable ht;
+    std::unordered_map<size_t, uint32_t> reference;
+    for (size_t key = 0u; key < key_count; ++key)
+    {
+        ht.insert(key, static_cast<uint32_t>(key * 7u));
+        reference.insert_or_assign(key, static_cast<uint32_t>(key * 7u));
+    }
+
+    // Erased keys leave tombstones behind in open addressing
+    for (size_t key = 0u; key < key_count; key += 3u)
+    {
+        ht.erase(key);
+        reference.erase(key);
+    }
+
+    bool failed = false;
+    try
+    {
+        CMappedHashTable<TTable>::save(ht, path);
+        CMappedHashTable<TTable> old_mapped(path);
+        auto old_reference = reference;
+
+        for (size_t key = key_count; key < 2u * key_count; key += 2u)
+        {
+            ht.insert(key, static_cast<uint32_t>(key));
+            reference.insert_or_assign(key, static_cast<uint32_t>(key));
+        }
+
+        CMappedHashTable<TTable>::save(ht, path);
+        CMappedHashTable<TTable> new_mapped(path);
+
+        failed |= !same_as_mapped(old_mapped, old_reference);
+        failed |= !same_as_mapped(new_mapped, reference);
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        failed = true;
+    }
+
+    std::remove(path.c_str());
+
+    return report(name, failed);
+}
+
+// Reads commands from map.in and writes lookup results to map.out
+static void run_map_file()
 {
     CCuckooHashTable<std::string, std::string> ht;
     // COpenDoubleAddrHashTable<std::string, std::string> ht;
     // COpenQuadroAddrHashTable<std::string, std::string> ht;
-    // COpenLinearAddrHashTable<std::string, std::string> ht;
-    // CChainHashTable<std::string, std::string> ht;
- 
+
     std::ifstream stream_in("map.in");
+    if (!stream_in)
+        return;
+
     std::ofstream stream_out("map.out");
- 
+
     std::string cmd, x, y;
     std::string none_str = "none";
     while (stream_in)
     {
         cmd.clear();
         stream_in >> cmd;
- 
+
         if (cmd == "put")
         {
             stream_in >> x >> y;
@@ -40,10 +600,202 @@ int main()
         {
             stream_in >> x;
             auto opt = ht.find(x);
- 
+
             stream_out << opt.value_or(none_str).get() << '\n';
         }
     }
- 
-    return 0;
+}
+
+int main()
+{
+    bool passed = true;
+
+    passed &= check_random_ops<CCuckooHashTable<size_t, std::string>>(
+            "CUCKOO");
+    passed &= check_random_ops<
+        CCuckooHashTable<size_t, std::string,
+                         SCollidingHasher, SCollidingHasher>>(
+            "CUCKOO COLLIDING OPS", 256u, NOps / 8u);
+    passed &= check_colliding<
+        CCuckooHashTable<size_t, std::string,
+                         SCollidingHasher, SCollidingHasher>>(
+            "CUCKOO COLLIDING");
+
+    passed &= check_random_ops<CSwissHashTable<size_t, std::string>>(
+            "SWISS");
+    passed &= check_random_ops<CSwissHashTable<size_t, std::string>>(
+            "SWISS FEW KEYS", 64u);
+
+    passed &= check_random_ops<CRobinHoodHashTable<size_t, std::string>>(
+            "ROBIN HOOD");
+    passed &= check_random_ops<CRobinHoodHashTable<size_t, std::string>>(
+            "ROBIN HOOD FEW KEYS", 64u);
+    passed &= check_steady_churn<CRobinHoodHashTable<size_t, std::string>>(
+            "ROBIN HOOD CHURN");
+
+    passed &= check_random_ops<CBucketCuckooHashTable<size_t, std::string>>(
+            "BUCKET CUCKOO");
+    passed &= check_random_ops<
+        CBucketCuckooHashTable<size_t, std::string, SCollidingHasher>>(
+            "BUCKET CUCKOO COLLIDING OPS", 256u, NOps / 8u);
+    passed &= check_colliding<
+        CBucketCuckooHashTable<size_t, std::string, SCollidingHasher>>(
+            "BUCKET CUCKOO COLLIDING");
+
+    using THash = std::hash<size_t>;
+    passed &= check_random_ops<
+        CDaryCuckooHashTable<size_t, std::string, THash, THash, THash>>(
+            "DARY CUCKOO 3");
+    passed &= check_random_ops<
+        CDaryCuckooHashTable<size_t, std::string,
+                             THash, THash, THash, THash>>(
+            "DARY CUCKOO 4");
+    passed &= check_random_ops<
+        CDaryCuckooHashTable<size_t, std::string, SCollidingHasher,
+                             SCollidingHasher, SCollidingHasher>>(
+            "DARY CUCKOO COLLIDING OPS", 256u, NOps / 8u);
+    passed &= check_colliding<
+        CDaryCuckooHashTable<size_t, std::string, SCollidingHasher,
+                             SCollidingHasher, SCollidingHasher>>(
+            "DARY CUCKOO COLLIDING");
+
+    passed &= check_random_ops<CChainHashTable<size_t, std::string>>(
+            "CHAIN");
+    passed &= check_random_ops<CChainHashTable<size_t, std::string>>(
+            "CHAIN FEW KEYS", 64u);
+    passed &= check_steady_churn<CChainHashTable<size_t, std::string>>(
+            "CHAIN CHURN");
+    passed &= check_copy<CChainHashTable<size_t, std::string>>(
+            "CHAIN COPY");
+
+    passed &= check_random_ops<CHopscotchHashTable<size_t, std::string>>(
+            "HOPSCOTCH");
+    passed &= check_random_ops<CHopscotchHashTable<size_t, std::string>>(
+            "HOPSCOTCH FEW KEYS", 64u);
+    passed &= check_random_ops<
+        CHopscotchHashTable<size_t, std::string, std::hash<size_t>, 10u,
+                            CPow2Capacity, 64u>>(
+            "HOPSCOTCH 64");
+    passed &= check_random_ops<
+        CHopscotchHashTable<size_t, std::string, SCollidingHasher>>(
+            "HOPSCOTCH COLLIDING OPS", 256u, NOps / 8u);
+    passed &= check_colliding<
+        CHopscotchHashTable<size_t, std::string, SCollidingHasher>>(
+            "HOPSCOTCH COLLIDING");
+
+    passed &= check_batches<CCuckooHashTable<size_t, std::string>>(
+            "CUCKOO BATCHES");
+    passed &= check_batches<
+        CCuckooHashTable<size_t, std::string, std::hash<size_t>,
+                         std::hash<size_t>, CPow2Capacity,
+                         CIncrementalRehash<>>>(
+            "CUCKOO INCREMENTAL BATCHES");
+    passed &= check_batches<CChainHashTable<size_t, std::string>>(
+            "CHAIN BATCHES");
+    passed &= check_batches<
+        CChainHashTable<size_t, std::string, std::hash<size_t>, 4u,
+                        CPow2Capacity, CIncrementalRehash<>>>(
+            "CHAIN INCREMENTAL BATCHES");
+    passed &= check_batches<COpenLinearAddrHashTable<size_t, std::string>>(
+            "LINEAR BATCHES");
+    passed &= check_batches<CSwissHashTable<size_t, std::string>>(
+            "SWISS BATCHES");
+
+    using TStrHash = CHasherAdapter<CMurmur3Hasher>;
+    passed &= check_heterogeneous<
+        CCuckooHashTable<std::string, std::string, TStrHash, TStrHash>>(
+            "CUCKOO HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CChainHashTable<std::string, std::string, TStrHash>>(
+            "CHAIN HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        COpenLinearAddrHashTable<std::string, std::string, TStrHash>>(
+            "LINEAR HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CSwissHashTable<std::string, std::string, TStrHash>>(
+            "SWISS HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CRobinHoodHashTable<std::string, std::string, TStrHash>>(
+            "ROBIN HOOD HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CBucketCuckooHashTable<std::string, std::string, TStrHash>>(
+            "BUCKET CUCKOO HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CDaryCuckooHashTable<std::string, std::string,
+                             TStrHash, TStrHash, TStrHash>>(
+            "DARY CUCKOO HETEROGENEOUS");
+    passed &= check_heterogeneous<
+        CHopscotchHashTable<std::string, std::string, TStrHash>>(
+            "HOPSCOTCH HETEROGENEOUS");
+
+    passed &= check_reserve<CCuckooHashTable<size_t, std::string>>(
+            "CUCKOO RESERVE");
+    passed &= check_reserve<CChainHashTable<size_t, std::string>>(
+            "CHAIN RESERVE");
+    passed &= check_reserve<COpenLinearAddrHashTable<size_t, std::string>>(
+            "LINEAR RESERVE");
+    passed &= check_reserve<COpenQuadroAddrHashTable<size_t, std::string>>(
+            "QUADRO RESERVE");
+    passed &= check_reserve<COpenDoubleAddrHashTable<size_t, std::string>>(
+            "DOUBLE RESERVE");
+    passed &= check_reserve<CSwissHashTable<size_t, std::string>>(
+            "SWISS RESERVE");
+    passed &= check_reserve<CRobinHoodHashTable<size_t, std::string>>(
+            "ROBIN HOOD RESERVE");
+    passed &= check_reserve<CBucketCuckooHashTable<size_t, std::string>>(
+            "BUCKET CUCKOO RESERVE");
+    passed &= check_reserve<
+        CDaryCuckooHashTable<size_t, std::string, THash, THash, THash>>(
+            "DARY CUCKOO RESERVE");
+    passed &= check_reserve<CHopscotchHashTable<size_t, std::string>>(
+            "HOPSCOTCH RESERVE");
+
+    using TShrink = CLowWatermarkShrink<>;
+    using TCuckooShrink =
+        CCuckooHashTable<size_t, std::string, THash, THash, CPow2Capacity,
+                         CFullRehash, TShrink>;
+    using TChainShrink =
+        CChainHashTable<size_t, std::string, THash, 4u, CPow2Capacity,
+                        CFullRehash, TShrink>;
+    using TLinearShrink =
+        COpenLinearAddrHashTable<size_t, std::string, THash, 4u,
+                                 CPow2Capacity, CFullRehash, TShrink>;
+    passed &= check_random_ops<TCuckooShrink>("CUCKOO SHRINK OPS");
+    passed &= check_random_ops<TChainShrink>("CHAIN SHRINK OPS");
+    passed &= check_random_ops<TLinearShrink>("LINEAR SHRINK OPS");
+    passed &= check_shrink<TCuckooShrink,
+                           CCuckooHashTable<size_t, std::string>>(
+            "CUCKOO SHRINK");
+    passed &= check_shrink<TChainShrink,
+                           CChainHashTable<size_t, std::string>>(
+            "CHAIN SHRINK");
+    passed &= check_shrink<TLinearShrink,
+                           COpenLinearAddrHashTable<size_t, std::string>>(
+            "LINEAR SHRINK");
+
+    passed &= check_perfect<CPerfectHashTable<size_t, std::string>>(
+            "PERFECT");
+    passed &= check_perfect<CPerfectHashTable<size_t, std::string>>(
+            "PERFECT LARGE", size_t{ 1u } << 20u);
+    passed &= check_perfect<
+        CPerfectHashTable<size_t, std::string, SCollidingHasher>>(
+            "PERFECT COLLIDING", 256u);
+    passed &= check_perfect_strings<
+        CPerfectHashTable<std::string, std::string, TStrHash>>(
+            "PERFECT STRINGS");
+
+    passed &= check_mapped<COpenLinearAddrHashTable<size_t, uint32_t>>(
+            "MAPPED LINEAR");
+    passed &= check_mapped<CCuckooHashTable<size_t, uint32_t>>(
+            "MAPPED CUCKOO");
+    // Only a few keys fit in the slots, the rest go to the stash and the
+    // overflow list, which must be saved too
+    passed &= check_mapped<
+        CCuckooHashTable<size_t, uint32_t,
+                         SCollidingHasher, SCollidingHasher>>(
+            "MAPPED CUCKOO COLLIDING", 64u);
+
+    run_map_file();
+
+    return (passed ? 0 : 1);
 }